@@ -18,6 +18,8 @@ parser.add_argument('--pretrained_llama_path', dest='pretrained_llama_path', typ
                     default="/data0/shared/data/public/opensource_models/meta-llama/Llama-2-7b-hf/")
 parser.add_argument('--onnx_model_path', dest='onnx_model_path', type=str, 
                     default="/data1/shared/llama")
+parser.add_argument('--compare_inplace', dest='compare_inplace', action='store_true',
+                    help='also build the model without in-place planning to compare peak memory')
 args = parser.parse_args()
 
 ONNX_MODEL_PATH = "{}/llama_bs{}_layer{}.onnx".format(args.onnx_model_path, args.batchsize, args.n_layers)
@@ -96,7 +98,15 @@ if __name__ == "__main__":
         print("will use exsiting onnx graph")
 
     onnx_model = onnx.load(ONNX_MODEL_PATH)
+    if args.compare_inplace:
+        # builds the whole model once more, weights included
+        before = OnnxStub(onnx_model, backend.cuda_runtime(), inplace_planning=False)
+        print("peak memory without in-place: {} bytes (lower bound {})".format(
+            before.handler.get_mem_peak(), before.handler.get_mem_lower_bound()))
+        del before
     stub = OnnxStub(onnx_model, backend.cuda_runtime())
+    print("peak memory with in-place: {} bytes (lower bound {})".format(
+        stub.handler.get_mem_peak(), stub.handler.get_mem_lower_bound()))
 
     count_wrong = 0
     for i in tqdm(range(0, args.n_max_length)):
@@ -1,3 +1,4 @@
+import argparse
 import sys
 import onnx
 import torch
@@ -6,6 +7,10 @@ from pyinfinitensor.onnx import OnnxStub, backend
 import torchvision.models as models
 
 if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--compare_inplace', action='store_true',
+                        help='also build the model without in-place planning to compare peak memory')
+    args = parser.parse_args()
     model_path = './resnet18.onnx'
     tv_model = models.resnet50(weights=None)
     input_shape = (1, 3, 224, 224)
@@ -13,7 +18,15 @@ if __name__ == '__main__':
     torch.onnx.export(tv_model, param, model_path, verbose=False)
 
     onnx_model = onnx.load(model_path)
+    if args.compare_inplace:
+        # builds the whole model once more, weights included
+        before = OnnxStub(onnx_model, backend.cuda_runtime(), inplace_planning=False)
+        print("peak memory without in-place: {} bytes (lower bound {})".format(
+            before.handler.get_mem_peak(), before.handler.get_mem_lower_bound()))
+        del before
     model = OnnxStub(onnx_model, backend.cuda_runtime())
+    print("peak memory with in-place: {} bytes (lower bound {})".format(
+        model.handler.get_mem_peak(), model.handler.get_mem_lower_bound()))
     images = np.random.random(input_shape).astype(np.float32)
     next(iter(model.inputs.values())).copyin_numpy(images)
     model.run()
@@ -11,14 +11,19 @@ class BlobObj {
     // Runtime might be replaced with a raw pointer for optimization
     Runtime runtime;
     void *ptr;
+    // Whether ptr is freed with the blob. Blobs pointing into an arena, such
+    // as the one of LazyAllocator, do not own it.
+    bool owned;
 
   public:
-    BlobObj(Runtime runtime, void *ptr) : runtime(runtime), ptr(ptr) {}
+    BlobObj(Runtime runtime, void *ptr, bool owned = false)
+        : runtime(runtime), ptr(ptr), owned(owned) {}
     BlobObj(BlobObj &other) = delete;
     BlobObj &operator=(BlobObj const &) = delete;
     ~BlobObj();
 
     template <typename T> T getPtr() const { return reinterpret_cast<T>(ptr); }
+    bool isOwned() const { return owned; }
 };
 
 } // namespace infini
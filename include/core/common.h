@@ -94,6 +94,47 @@ double timeit(
     const std::function<void(void)> &sync = []() {}, int warmupRounds = 10,
     int timingRounds = 10);
 
+/**
+ * @brief Statistics of repeated timings, in milliseconds.
+ */
+struct TimingStats {
+    double mean = 0, median = 0, p10 = 0, p90 = 0, stddev = 0;
+    int rounds = 0;
+};
+
+struct TimingConfig {
+    int warmupRounds = 3;
+    int minRounds = 5;
+    int maxRounds = 200;
+    // Stop repeating once the timed rounds take this long, in milliseconds
+    double maxTime = 1000;
+    // Stop repeating once the 95% confidence interval of the mean is within
+    // this fraction of the median
+    double relativeCI = 0.02;
+    // Evict the caches before each round by writing `flushBytes` of memory
+    bool flushCache = false;
+    size_t flushBytes = 64 << 20;
+    // Pin the calling thread to this CPU while timing if non-negative (Linux
+    // only). Threads created while pinned inherit the affinity, so leave it
+    // off for kernels whose OpenMP team is not created yet.
+    int pinCpu = -1;
+
+    // The config used by kernels' tune
+    static TimingConfig &getDefault() {
+        static TimingConfig config;
+        return config;
+    }
+};
+
+/**
+ * @brief Time each round of `func` separately, repeating adaptively between
+ * `minRounds` and `maxRounds` until the confidence interval is tight.
+ */
+TimingStats timeitStats(
+    const std::function<void()> &func,
+    const std::function<void(void)> &sync = []() {},
+    const TimingConfig &config = TimingConfig::getDefault());
+
 std::vector<int64_t> castTo64(std::vector<int> const &v32);
 
 } // namespace infini
@@ -0,0 +1,72 @@
+#pragma once
+#include "core/graph.h"
+#include "core/operator.h"
+
+namespace infini {
+
+/**
+ * @brief Estimates the cost of operators without running them. SearchEngine
+ * ranks candidate graphs with a cost model. A lower cost is better.
+ */
+class CostModelObj {
+  public:
+    virtual ~CostModelObj() {}
+    virtual double estimate(const Operator &op) const = 0;
+    /**
+     * @brief The cost of a graph is the sum of the cost of its operators.
+     */
+    double estimate(const Graph &graph) const;
+    virtual string toString() const = 0;
+};
+using CostModel = Ref<CostModelObj>;
+
+/**
+ * @brief The weighted sum of the perf metrics of an operator, i.e.
+ * computeTime + 0.5 * memoryCost - 0.2 * parallelism. It does not depend on
+ * the machine.
+ */
+class HeuristicCostModelObj : public CostModelObj {
+  public:
+    double estimate(const Operator &op) const override;
+    using CostModelObj::estimate;
+    string toString() const override { return "HeuristicCostModel"; }
+};
+
+/**
+ * @brief Roofline model. An operator is bound either by the compute throughput
+ * of the cores it can occupy or by the memory bandwidth, and the estimate is
+ * its time in seconds.
+ *
+ * OperatorObj::getComputeTime is a time on a nominal machine, so its product
+ * with `nominalFlops` is taken as the workload of the operator. The parameters
+ * are measured in the same unit by `calibrate`.
+ */
+class RooflineCostModelObj : public CostModelObj {
+  public:
+    static constexpr double nominalFlops = 1e9;
+
+  private:
+    double peakFlops;    // nominal operations per second of all cores
+    double memBandwidth; // bytes per second
+    int numCores;
+
+  public:
+    RooflineCostModelObj(double peakFlops, double memBandwidth, int numCores);
+    double estimate(const Operator &op) const override;
+    using CostModelObj::estimate;
+    string toString() const override;
+
+    double getPeakFlops() const { return peakFlops; }
+    double getMemBandwidth() const { return memBandwidth; }
+    int getNumCores() const { return numCores; }
+
+    /**
+     * @brief Fit the parameters by timing microbenchmarks on `runtime`: Matmul
+     * for the compute throughput and Add for the memory bandwidth. The core
+     * count is the number of OpenMP threads.
+     */
+    static Ref<RooflineCostModelObj>
+    calibrate(Runtime runtime = NativeCpuRuntimeObj::getInstance());
+};
+
+} // namespace infini
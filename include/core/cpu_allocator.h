@@ -0,0 +1,81 @@
+#pragma once
+#include "core/common.h"
+#include <mutex>
+#include <unordered_map>
+
+namespace infini {
+
+// How large buffers of the CPU allocator are backed
+enum class HugePageMode {
+    // regular pages
+    None,
+    // regular mapping with madvise(MADV_HUGEPAGE), huge pages if the kernel
+    // has them to spare
+    Transparent,
+    // MAP_HUGETLB from the reserved pool, falling back to Transparent when
+    // the pool is exhausted
+    Explicit,
+};
+
+struct CpuAllocConfig {
+    // alignment of every buffer, a power of 2; buffers mapped directly are
+    // page aligned
+    size_t alignment = 64;
+    // buffers of at least this many bytes, e.g. the weight and activation
+    // arenas of LazyAllocator, are mapped directly with `hugePages`
+    size_t mapThreshold = 2 << 20;
+    HugePageMode hugePages = HugePageMode::Transparent;
+    // touch the pages of mapped buffers from a static OpenMP loop, so that
+    // each page lands on the NUMA node of the thread that will work on it
+    bool numaFirstTouch = true;
+    // zero buffers below mapThreshold; mapped buffers are always zero
+    bool zeroFill = false;
+};
+
+struct CpuAllocStats {
+    size_t allocs = 0;
+    size_t frees = 0;
+    size_t bytesInUse = 0;
+    size_t peakBytes = 0;
+    // bytes currently in mapped buffers
+    size_t mappedBytes = 0;
+    // bytes currently backed by MAP_HUGETLB
+    size_t hugeTlbBytes = 0;
+    // Explicit mappings that fell back to Transparent
+    size_t hugeTlbFallbacks = 0;
+};
+
+/**
+ * @brief The allocator behind NativeCpuRuntimeObj::alloc.
+ *
+ * Small buffers come from aligned_alloc. Large ones are mapped anonymously,
+ * which skips the allocator's zero fill and lets them use huge pages and
+ * first-touch NUMA placement. Thread safe.
+ */
+class CpuAllocator {
+    CpuAllocConfig config;
+    CpuAllocStats stats;
+    // size and kind of each live buffer, needed to release it
+    struct Allocation {
+        size_t bytes;
+        bool mapped;
+        bool hugeTlb;
+    };
+    std::unordered_map<void *, Allocation> allocations;
+    mutable std::mutex mutex;
+
+  public:
+    void *alloc(size_t size);
+    void dealloc(void *ptr);
+
+    // Applies to buffers allocated afterwards
+    void setConfig(const CpuAllocConfig &config);
+    CpuAllocConfig getConfig() const;
+    CpuAllocStats getStats() const;
+    string toString() const;
+
+  private:
+    void *map(size_t bytes, bool &hugeTlb);
+};
+
+} // namespace infini
@@ -17,7 +17,12 @@ class GraphObj : public Object {
   public:
     explicit GraphObj(Runtime runtime)
         : runtime(runtime), allocator(runtime), sorted(false){};
-    GraphObj(Runtime runtime, OpVec ops_in);
+    /**
+     * @brief Clone `ops_in` and their tensors into a new graph. Tensor data
+     * is shared copy-on-write, or dropped if `cloneData` is false, e.g. for
+     * the candidate graphs built during search.
+     */
+    GraphObj(Runtime runtime, OpVec ops_in, bool cloneData = true);
     string toString() const override;
     Runtime getRuntime() const { return runtime; }
 
@@ -27,19 +32,21 @@ class GraphObj : public Object {
     /**
      * @brief Clone a tensor and add it to the graph.
      */
-    Tensor cloneTensor(const Tensor &tensor) {
-        return addTensor(tensor->clone(runtime));
+    Tensor cloneTensor(const Tensor &tensor, bool cloneData = true) {
+        return addTensor(tensor->clone(runtime, cloneData));
     }
     void removeOperator(Operator op) {
         auto it = std::find(ops.begin(), ops.end(), op);
         if (it != ops.end())
             ops.erase(it);
+        allocator.clearPlanCache();
     }
 
     void removeTensor(Tensor tensor) {
         auto it = std::find(tensors.begin(), tensors.end(), tensor);
         if (it != tensors.end())
             tensors.erase(it);
+        allocator.clearPlanCache();
     }
 
     void deleteConnection(Tensor tensor, Operator op);
@@ -71,6 +78,51 @@ class GraphObj : public Object {
 
     void dataMalloc(bool useNaiveAllocator = false, size_t memPoolSize = 0);
 
+    /**
+     * @brief Select how dataMalloc places the non-weight tensors. The offline
+     * strategies plan all lifetimes at once instead of allocating op by op.
+     */
+    void setMemPlanStrategy(MemPlanStrategy strategy) {
+        memPlanStrategy = strategy;
+    }
+    MemPlanStrategy getMemPlanStrategy() const { return memPlanStrategy; }
+    /**
+     * @brief Whether dataMalloc lets the output of an in-place safe kernel
+     * reuse the buffer of an input that dies at the op. On by default.
+     */
+    void setInPlacePlanning(bool enable) { inPlacePlanning = enable; }
+    /**
+     * @brief Whether CpuRuntimeObj::run executes the independent ops of each
+     * level (see getOpLevels) concurrently. dataMalloc then measures
+     * lifetimes in levels, so that tensors of concurrent ops never share
+     * memory. Off by default.
+     */
+    void setInterOpParallel(bool enable) { interOpParallel = enable; }
+    bool isInterOpParallel() const { return interOpParallel; }
+    /**
+     * @brief The level of each op of the sorted graph: 0 for ops without
+     * predecessors, else one more than the highest level of its
+     * predecessors. Ops of the same level are independent.
+     */
+    vector<size_t> getOpLevels() const;
+    /**
+     * @brief Map the weights from a file written by saveWeights instead of
+     * allocating them. Call before the first dataMalloc; the weights then need
+     * no copyin.
+     */
+    void setWeightFile(const string &path);
+    /**
+     * @brief Write the weights, as dataMalloc laid them out, to a file for
+     * setWeightFile.
+     */
+    void saveWeights(const string &path);
+    const LazyAllocator &getAllocator() const { return allocator; }
+    /**
+     * @brief The plan CpuRuntimeObj::compile last built for this graph.
+     */
+    RunPlan getRunPlan() const { return runPlan; }
+    void setRunPlan(RunPlan plan) { runPlan = std::move(plan); }
+
     Tensor cloneKV(Tensor &tensor);
 
     void freeHeap();
@@ -125,6 +177,20 @@ class GraphObj : public Object {
      */
     void addOperatorAndConnect(const Operator &op);
 
+    /**
+     * @brief Place the non-weight tensors with the allocator, as selected by
+     * memPlanStrategy. Outputs of metadata-only ops share their input's
+     * buffer, and outputs of in-place ops the buffer of a dying input.
+     */
+    void planMemory(const vector<TensorObj *> &plannedTensors,
+                    std::unordered_map<TensorObj *, size_t> &tensorToOffset);
+
+    /**
+     * @brief The signature under which the memory plan is cached: the
+     * planning options and the shapes of the graph inputs.
+     */
+    vector<int> getMemPlanKey() const;
+
     /**
      * @brief If the nodes is sorted in topological order.
      */
@@ -134,6 +200,14 @@ class GraphObj : public Object {
      * @brief If the weight tensors are allocated.
      */
     bool weightAllocated = false;
+
+    MemPlanStrategy memPlanStrategy = MemPlanStrategy::Online;
+
+    bool inPlacePlanning = true;
+
+    bool interOpParallel = false;
+
+    RunPlan runPlan;
 };
 
 } // namespace infini
@@ -139,6 +139,30 @@ class GraphHandlerObj {
         g->dataMalloc(useNaiveAllocator, memPoolSize);
     }
 
+    inline void set_mem_plan_strategy(MemPlanStrategy strategy) {
+        g->setMemPlanStrategy(strategy);
+    }
+
+    inline void set_inplace_planning(bool enable) {
+        g->setInPlacePlanning(enable);
+    }
+
+    inline void set_inter_op_parallel(bool enable) {
+        g->setInterOpParallel(enable);
+    }
+
+    inline void set_weight_file(const string &path) {
+        g->setWeightFile(path);
+    }
+
+    inline void save_weights(const string &path) { g->saveWeights(path); }
+
+    inline size_t get_mem_peak() { return g->getAllocator().getPeak(); }
+
+    inline size_t get_mem_lower_bound() {
+        return g->getAllocator().getLowerBound();
+    }
+
     inline Tensor clone_KV(Tensor &tensor) { return g->cloneKV(tensor); }
 
     inline void free_heap() { g->freeHeap(); }
@@ -4,7 +4,9 @@
 #include "core/tensor.h"
 #include "utils/operator_utils.h"
 #include <functional>
+#include <mutex>
 #include <nlohmann/json.hpp>
+#include <shared_mutex>
 namespace infini {
 using json = nlohmann::json;
 
@@ -13,15 +15,28 @@ class RuntimeObj; // Forward declaration for Kernel::compute
 struct PerfRecordObj {
     PerfRecordObj(){};
     PerfRecordObj(double time) : time(time){};
+    // The median is robust to outliers, so it is taken as the time
+    PerfRecordObj(const TimingStats &stats)
+        : time(stats.median), stats(stats){};
     virtual ~PerfRecordObj(){};
     double time = 0; // in milliseconds
+    TimingStats stats; // empty (0 rounds) if not measured by timeitStats
     virtual void to_json(json &j) {
         j["type"] = 0;
         j["data"] = time;
+        if (stats.rounds > 0)
+            j["stats"] = std::make_tuple(stats.mean, stats.median, stats.p10,
+                                         stats.p90, stats.stddev,
+                                         stats.rounds);
     }
     static Ref<PerfRecordObj> from_json(const json &j) {
         PerfRecordObj tmp;
-        tmp.time = j["data"].get<int>();
+        tmp.time = j["data"].get<double>();
+        if (j.contains("stats"))
+            std::tie(tmp.stats.mean, tmp.stats.median, tmp.stats.p10,
+                     tmp.stats.p90, tmp.stats.stddev, tmp.stats.rounds) =
+                j["stats"].get<tuple<double, double, double, double, double,
+                                     int>>();
         return make_ref<PerfRecordObj>(tmp);
     }
 };
@@ -60,11 +75,17 @@ class Kernel {
     virtual PerfRecord tune(const Operator &op,
                             const RuntimeObj *context) const = 0;
 
+    // Whether the output may share the buffer of an input of the same shape,
+    // i.e. each output element only depends on the input elements at the same
+    // position, which are read before it is written. See
+    // GraphObj::planMemory.
+    virtual bool supportsInPlace() const { return false; }
+
     // Find the optimal computing function by comparing its running time
     virtual void computeFuncTune(const Key perfKey, const Operator &op,
                                  const PerfRecord &record,
                                  const RuntimeObj *context) {
-        if (funcVec.empty()) {
+        if (funcVec.empty() || computeMap.find(perfKey) != computeMap.end()) {
             return;
         }
         double t = std::numeric_limits<double>::max();
@@ -137,6 +158,8 @@ class KernelRegistry {
   private:
     std::map<KernelAttrs, KernelRecord> kernels;
     int nKernels = 0;
+    // Kernels are looked up from multiple threads during search
+    mutable std::shared_mutex kernelsMutex;
 
   public:
     ~KernelRegistry() {
@@ -149,19 +172,26 @@ class KernelRegistry {
     }
     bool registerKernel(const KernelAttrs &key, Kernel *kernel, string name) {
         // TODO: mutliple kernels support: priority and check name
+        std::unique_lock lock(kernelsMutex);
         IT_ASSERT(kernels.find(key) == kernels.end(),
                   "Kernel already registered");
         kernels.emplace(key, KernelRecord{kernel, name, ++nKernels});
         return true;
     }
     Kernel *getKernel(const KernelAttrs &kernelAttrs) const {
+        std::shared_lock lock(kernelsMutex);
         auto it = kernels.find(kernelAttrs);
         IT_ASSERT(it != kernels.end(), "Kernel not found for key {" +
                                            get_kernel_attrs_str(kernelAttrs) +
                                            "}");
         return std::get<0>(it->second);
     }
+    bool hasKernel(const KernelAttrs &kernelAttrs) const {
+        std::shared_lock lock(kernelsMutex);
+        return kernels.find(kernelAttrs) != kernels.end();
+    }
     const KernelRecord &getKernelItem(const KernelAttrs &kernelAttrs) const {
+        std::shared_lock lock(kernelsMutex);
         return kernels.at(kernelAttrs);
     }
 };
@@ -177,7 +207,8 @@ class CpuKernelWithoutConfig : public Kernel {
     // Premise: op is idempotent since it is called multiple times.
     virtual PerfRecord tune(const Operator &op,
                             const RuntimeObj *context) const override {
-        return make_ref<PerfRecordObj>(timeit([&]() { compute(op, context); }));
+        return make_ref<PerfRecordObj>(
+            timeitStats([&]() { compute(op, context); }));
     }
 };
 
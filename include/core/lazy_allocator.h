@@ -10,6 +10,23 @@
 
 namespace infini {
 
+// How GraphObj::dataMalloc places the non-weight tensors
+enum class MemPlanStrategy {
+    // best-fit alloc and free, one op at a time in topological order
+    Online,
+    // offline: the largest tensors are placed first
+    GreedyBySize,
+    // offline: the tensors live at the steps with the most live bytes are
+    // placed first
+    GreedyByBreadth,
+};
+
+// A block of `size` bytes, live from step `begin` to step `end` inclusive
+struct MemBlockLifetime {
+    size_t size;
+    size_t begin, end;
+};
+
 class LazyAllocator {
   private:
 #ifdef BUILD_TEST
@@ -28,6 +45,9 @@ class LazyAllocator {
 
     size_t heapPeak = 0;
 
+    // the largest sum of live block sizes at any step, a lower bound of peak
+    size_t lowerBound = 0;
+
     size_t alignment;
 
     bool hasMemPool = false;
@@ -43,9 +63,39 @@ class LazyAllocator {
     // memory pool ptr
     void *memPoolPtr = nullptr;
 
-    // // a cache designed for a batch size that has already occurred
-    // std::unordered_map<size_t, std::unordered_map<TensorObj *, size_t>>
-    // batchsizeToTensorOffset;
+    // sizes of the weight blocks before alignment, in the order allocWeight
+    // placed them
+    vector<size_t> weightSizes;
+
+    // file the weight arena is mapped from instead of allocated, if any
+    string weightFile;
+
+    // mapping of weightFile that weightPtr points into, released by the
+    // destructor
+    void *weightMap = nullptr;
+
+    size_t weightMapSize = 0;
+
+    // capacity of the memory pointed to by ptr, which is only reallocated to
+    // grow
+    size_t ptrSize = 0;
+
+    // whether ptr has been handed out since the last init
+    bool ptrBound = false;
+
+  public:
+    // a complete placement of the non-weight tensors of a graph
+    struct MemPlan {
+        vector<TensorObj *> tensors;
+        vector<size_t> bytes;
+        vector<size_t> offsets;
+        size_t used, peak, lowerBound;
+    };
+
+  private:
+    // plans already made, keyed by the shapes of the graph inputs, so that
+    // switching back to a known shape does not plan again
+    std::map<vector<int>, MemPlan> planCache;
 
     struct freeBlockInfo {
         size_t addr;
@@ -93,6 +143,20 @@ class LazyAllocator {
 
     void freeHeap();
 
+    // function: place all blocks at once, with their lifetimes known in
+    // advance, instead of through alloc and free
+    // arguments:
+    //     blocks: sizes and lifetimes of the blocks to be placed
+    //     strategy: the order in which blocks are placed
+    // return: head address offset of each block
+    vector<size_t> planOffline(const vector<MemBlockLifetime> &blocks,
+                               MemPlanStrategy strategy);
+
+    // function: record the lower bound of peak for the blocks, to be
+    // reported by info()
+    // return: the largest sum of aligned live block sizes at any step
+    size_t boundPeak(const vector<MemBlockLifetime> &blocks);
+
     // function: simulate memory free
     // arguments:
     //     addr: head address offset of memory block to be free
@@ -103,17 +167,56 @@ class LazyAllocator {
     // return: pointer to the head address of the allocated memory
     void *getPtr();
 
-    // void addCache(size_t batchsize, std::unordered_map<TensorObj *, size_t>);
-
-    // std::unordered_map<TensorObj *, size_t> getCache(size_t batchsize);
+    // function: restore a plan saved for the same key, if it places the same
+    // tensors with the same sizes
+    // arguments:
+    //     key: signature of the graph inputs
+    //     tensors: the tensors to be placed
+    //     tensorToOffset: filled with the offsets of the plan
+    // return: whether a plan was restored
+    bool loadPlan(const vector<int> &key, const vector<TensorObj *> &tensors,
+                  std::unordered_map<TensorObj *, size_t> &tensorToOffset);
+
+    // function: cache the current plan under the key
+    void
+    savePlan(const vector<int> &key, const vector<TensorObj *> &tensors,
+             const std::unordered_map<TensorObj *, size_t> &tensorToOffset);
+
+    size_t getPlanCacheSize() const { return planCache.size(); }
+    // function: drop the cached plans, whose tensor lifetimes are stale once
+    // the graph topology changes
+    void clearPlanCache() { planCache.clear(); }
 
     void *getWeightPtr();
 
+    // function: serve the weight arena from a file written by saveWeights
+    // instead of allocating it. On CPU the file is mapped copy-on-write, so
+    // weights stay in the page cache, shared by every process mapping the
+    // file, and are copied only if written (e.g. kvcache)
+    // arguments:
+    //     path: the weight file, checked against the allocWeight layout when
+    //     the arena is first requested
+    void setWeightFile(const string &path);
+
+    bool hasWeightFile() const { return !weightFile.empty(); }
+
+    // function: write the weight arena, with the layout of allocWeight, to a
+    // file that setWeightFile can map
+    void saveWeights(const string &path);
+
     void *getHeapPtr();
 
+    size_t getPeak() const { return peak; }
+
+    size_t getLowerBound() const { return lowerBound; }
+
     void info();
 
   private:
+    // function: map weightFile and check that its layout matches
+    // return: pointer to the weight arena
+    void *mapWeightFile();
+
     // function: memory alignment, rouned up
     // return: size of the aligned memory block
     size_t getAlignedSize(size_t size);
@@ -1,6 +1,7 @@
 #pragma once
 #include "core/common.h"
 #include "ref.h"
+#include <atomic>
 
 namespace infini {
 
@@ -20,7 +21,8 @@ class Uid {
 class Guid : public Uid {
   private:
     UidBaseType generateGuid() {
-        static UidBaseType guidCnt = 0;
+        // Atomic since graphs are cloned concurrently during search
+        static std::atomic<UidBaseType> guidCnt = 0;
         return ++guidCnt;
     }
 
@@ -35,7 +37,7 @@ class Guid : public Uid {
 class Fuid : public Uid {
   private:
     UidBaseType generateFuid() {
-        static UidBaseType fuidCnt = 0;
+        static std::atomic<UidBaseType> fuidCnt = 0;
         return ++fuidCnt;
     }
 
@@ -257,6 +257,7 @@ struct OpType {
     bool isPool() const;
     bool isGlobalPool() const;
     bool isMatMulOrConv() const;
+    bool isView() const;
 };
 
 enum class ActType {
@@ -1,7 +1,14 @@
 #pragma once
 #include "core/graph.h"
+#include "core/hash.h"
 #include "core/kernel.h"
+#include "core/perf_predictor.h"
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <mutex>
 #include <nlohmann/json_fwd.hpp>
+#include <shared_mutex>
 namespace infini {
 using json = nlohmann::json;
 
@@ -10,13 +17,57 @@ class PerfEngine {
     // TODO: Key should be OpPerfKey + Context(maybe implicat) to support
     // multiple candiate kernels.
     using Key = std::pair<KernelAttrs, OpPerfKey>;
+    struct KeyHash {
+        size_t operator()(const Key &key) const {
+            auto &[device, opType] = key.first;
+            HashType hash = key.second.hash;
+            hash = hashAppend(hash, enum_to_underlying(device));
+            hash = hashAppend(hash, opType);
+            return hash;
+        }
+    };
+    /**
+     * @brief How to resolve a key that exists both in PerfEngine and in the
+     * loaded records.
+     */
+    enum class MergePolicy { Overwrite, KeepExisting, KeepFaster };
+
     PerfEngine() = default;
     // PerfEngine is singleton
     PerfEngine(PerfEngine &other) = delete;
     PerfEngine &operator=(PerfEngine const &) = delete;
 
   private:
-    map<Key, PerfRecord> data;
+    // Records are sharded by key hash, and each shard has its own lock, so
+    // that candidate graphs can be evaluated concurrently without contending
+    // on a single lock. Lookups take a shared lock and inserts an exclusive
+    // one.
+    static constexpr size_t numShards = 16;
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<Key, PerfRecord, KeyHash> data;
+    };
+    std::array<Shard, numShards> shards;
+    // Bumped whenever records change, so that compiled run plans can tell
+    // whether the records they resolved are still current
+    std::atomic<size_t> version{0};
+    // Serializes kernel tuning, so that concurrent tuning does not perturb the
+    // measured time of each other.
+    std::mutex tuneMutex;
+    // Answers queries of unseen keys without tuning if set
+    Ref<PerfPredictor> predictor;
+    mutable std::shared_mutex predictorMutex;
+    // New records are appended to this file if it is open
+    std::ofstream logFile;
+    std::mutex logMutex;
+
+    Shard &getShard(const Key &key) {
+        return shards[KeyHash()(key) % numShards];
+    }
+    const Shard &getShard(const Key &key) const {
+        return shards[KeyHash()(key) % numShards];
+    }
+    void appendToLog(const Key &key, const PerfRecord &record);
 
   public:
     static PerfEngine &getInstance() {
@@ -29,22 +80,98 @@ class PerfEngine {
      *
      * @return PerfRecord nullptr if no record is fnoud.
      */
-    PerfRecord getPerfData(const Key &key) {
-        auto it = data.find(key);
-        if (it != data.end()) // find previous evaluating results
-            return data.at(key);
+    PerfRecord getPerfData(const Key &key) const {
+        auto &shard = getShard(key);
+        std::shared_lock lock(shard.mutex);
+        auto it = shard.data.find(key);
+        if (it != shard.data.end()) // find previous evaluating results
+            return it->second;
         else
             return nullptr;
     }
 
     void setPerfData(const Key &key, PerfRecord record) {
-        IT_ASSERT(data.find(key) == data.end(), "Perf data already exist");
-        data.emplace(key, record);
+        {
+            auto &shard = getShard(key);
+            std::unique_lock lock(shard.mutex);
+            IT_ASSERT(shard.data.find(key) == shard.data.end(),
+                      "Perf data already exist");
+            shard.data.emplace(key, record);
+        }
+        ++version;
+        appendToLog(key, record);
+    }
+    /**
+     * @brief Get the perf record of `key`, running `tune` to create it if
+     * there is no record. Tuning is serialized across threads and runs at most
+     * once per key.
+     */
+    PerfRecord getOrTunePerfData(const Key &key,
+                                 const std::function<PerfRecord()> &tune) {
+        if (auto record = getPerfData(key))
+            return record;
+        std::lock_guard tuneLock(tuneMutex);
+        // Another thread may have tuned the same key while we were waiting
+        if (auto record = getPerfData(key))
+            return record;
+        auto record = tune();
+        setPerfData(key, record);
+        return record;
+    }
+    /**
+     * @brief Predict the perf record of `key` with the predictor. The result
+     * is not stored, since it is not measured.
+     *
+     * @return PerfRecord nullptr if there is no predictor or the prediction is
+     * not confident enough.
+     */
+    PerfRecord predictPerfData(const Key &key) const {
+        std::shared_lock lock(predictorMutex);
+        return predictor ? predictor->predictRecord(key) : nullptr;
     }
-    map<Key, PerfRecord> get_data() { return data; }
-    void set_data(map<Key, PerfRecord> data) { this->data = data; }
+    void setPredictor(Ref<PerfPredictor> p) {
+        std::unique_lock lock(predictorMutex);
+        predictor = p;
+    }
+    Ref<PerfPredictor> getPredictor() const {
+        std::shared_lock lock(predictorMutex);
+        return predictor;
+    }
+    size_t size() const;
+    size_t getVersion() const { return version; }
+    map<Key, PerfRecord> get_data() const;
+    void set_data(const map<Key, PerfRecord> &data);
+    /**
+     * @brief Insert `data` into the existing records, resolving duplicated
+     * keys by `policy`.
+     *
+     * @return size_t The number of inserted or replaced records.
+     */
+    size_t merge_data(const map<Key, PerfRecord> &data,
+                      MergePolicy policy = MergePolicy::Overwrite);
     void savePerfEngineData(std::string file_path);
     void loadPerfEngineData(std::string file_path);
+
+    /**
+     * @brief Save all records to a versioned binary file. See perf_engine.cc
+     * for the layout.
+     */
+    void savePerfEngineBinary(const std::string &file_path) const;
+    /**
+     * @brief Merge the records of a binary file, e.g. one collected on another
+     * machine, into PerfEngine. A truncated record at the end of the file,
+     * left by an interrupted append, is ignored.
+     *
+     * @return size_t The number of inserted or replaced records.
+     */
+    size_t loadPerfEngineBinary(const std::string &file_path,
+                                MergePolicy policy = MergePolicy::Overwrite);
+    /**
+     * @brief Load the records of a binary file if it exists, and append every
+     * record created afterwards to it, so that tuning results survive
+     * crashes and are shared by later runs. An empty path closes the file.
+     */
+    void attachPerfEngineBinary(const std::string &file_path);
 };
 void to_json(json &j, const PerfEngine &p);
 void from_json(const json &j, PerfEngine &p);
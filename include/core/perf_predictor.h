@@ -0,0 +1,75 @@
+#pragma once
+#include "core/kernel.h"
+#include "core/operator.h"
+#include <nlohmann/json_fwd.hpp>
+
+namespace infini {
+using json = nlohmann::json;
+
+/**
+ * @brief Predicts the time of kernels from the records in PerfEngine, so that
+ * unseen workloads can be costed without tuning.
+ *
+ * One model is trained for each kernel and length of the workload vector of
+ * OpPerfKey. A model is a ridge regression of log(time) on log(1 + x) of the
+ * workload vector, i.e. a power law of the shape, which fits the usual
+ * products of dimensions in operator workloads.
+ */
+class PerfPredictor {
+  public:
+    using Key = std::pair<KernelAttrs, OpPerfKey>;
+    using Records = map<Key, PerfRecord>;
+
+    struct Prediction {
+        double time = 0; // in milliseconds
+        /**
+         * @brief In [0, 1]. It decays with the leave-one-out error of the
+         * model in log space and with the distance that the query extrapolates
+         * out of the trained range. 0 if there is no model for the key.
+         */
+        double confidence = 0;
+    };
+
+    struct Model {
+        vector<double> weights; // weights[0] is the bias
+        vector<double> minFeatures, maxFeatures;
+        double looError = 0; // RMS leave-one-out error of log(time)
+        size_t numSamples = 0;
+    };
+    using ModelKey = tuple<Device, OpType::underlying_t, size_t>;
+
+  private:
+    map<ModelKey, Model> models;
+    double threshold = 0.8;
+
+  public:
+    PerfPredictor() = default;
+
+    /**
+     * @brief Fit models to `records`, replacing the current ones. Groups with
+     * fewer than `minSamples` records are skipped.
+     */
+    void train(const Records &records, size_t minSamples = 4);
+    Prediction predict(const Key &key) const;
+    /**
+     * @brief Predicts the time of `key` if the confidence reaches the
+     * threshold.
+     *
+     * @return PerfRecord nullptr if the prediction is not confident enough.
+     */
+    PerfRecord predictRecord(const Key &key) const;
+
+    void setConfidenceThreshold(double confidence) { threshold = confidence; }
+    double getConfidenceThreshold() const { return threshold; }
+    size_t getNumModels() const { return models.size(); }
+    const map<ModelKey, Model> &getModels() const { return models; }
+    void setModels(map<ModelKey, Model> m) { models = std::move(m); }
+
+    void save(const std::string &file_path) const;
+    void load(const std::string &file_path);
+};
+
+void to_json(json &j, const PerfPredictor &p);
+void from_json(const json &j, PerfPredictor &p);
+
+} // namespace infini
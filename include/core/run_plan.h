@@ -0,0 +1,49 @@
+#pragma once
+#include "core/kernel.h"
+
+namespace infini {
+
+/**
+ * @brief A graph compiled by CpuRuntimeObj::compile: the kernel, perf record
+ * and compute function of each op, resolved once so that run only replays
+ * them.
+ *
+ * The plan stays valid while the graph has the same ops, their operands keep
+ * their data pointers and dims, and no perf record is added.
+ */
+class RunPlanObj {
+  public:
+    struct Step {
+        Operator op;
+        Kernel *kernel;
+        // registered name of the kernel, for tracing
+        string kernelName;
+        // nullptr if the op has no perf record and runs with the default
+        // argument through kernel->compute
+        PerfRecord record;
+        ComputeFuncPtr func;
+    };
+
+  private:
+    vector<Step> steps;
+    // indices of the steps of each level, for concurrent execution; empty if
+    // the steps run one by one
+    vector<vector<size_t>> levels;
+    // data pointer and dims of the operands of each step, in order
+    vector<void *> operandPtrs;
+    vector<Shape> operandShapes;
+    size_t perfVersion;
+
+  public:
+    // `stepLevels` is the level of each step, or empty to run them in order
+    RunPlanObj(vector<Step> steps, const vector<size_t> &stepLevels,
+               size_t perfVersion);
+
+    const vector<Step> &getSteps() const { return steps; }
+    const vector<vector<size_t>> &getLevels() const { return levels; }
+    // Whether the plan still matches `ops` and the perf records of version
+    // `perfVersion`
+    bool isValid(const OpVec &ops, size_t perfVersion) const;
+};
+
+} // namespace infini
@@ -1,9 +1,11 @@
 #pragma once
 #include "core/common.h"
 #include "core/communicator.h"
+#include "core/cpu_allocator.h"
 #include "core/op_type.h"
 #include "core/ref.h"
 #include <memory>
+#include <optional>
 
 namespace infini {
 
@@ -23,6 +25,7 @@ class GraphHandlerObj;
 class RuntimeObj;
 class BlobObj;
 template <typename T> class WorkspaceObj;
+class RunPlanObj;
 
 using TensorBase = Ref<TensorBaseObj>;
 using Tensor = Ref<TensorObj>;
@@ -32,6 +35,7 @@ using GraphHandler = Ref<GraphHandlerObj>;
 using Runtime = Ref<RuntimeObj>;
 using Blob = Ref<BlobObj>;
 template <typename T> using Workspace = Ref<WorkspaceObj<T>>;
+using RunPlan = Ref<RunPlanObj>;
 
 using TensorVec = vector<Tensor>;
 using OpVec = vector<Operator>;
@@ -62,6 +66,12 @@ class RuntimeObj : public std::enable_shared_from_this<RuntimeObj> {
      * @return PerfMetrics 返回性能指标结构体
      */
     PerfMetrics getPerfMetrics(const Graph &graph, bool profiling = false) const;
+
+    /**
+     * @brief Fold the perf metrics of a graph into a single score with
+     * HeuristicCostModelObj. A lower score means a better graph.
+     */
+    double getPerfScore(const Graph &graph) const;
     
     /**
      * @brief 判断是否应该进行算子融合
@@ -93,6 +103,15 @@ class RuntimeObj : public std::enable_shared_from_this<RuntimeObj> {
      * @return double Return the sum of perf time for each operator
      */
     double getPerfTime(const Graph &graph, bool profiling = false) const;
+    /**
+     * @brief The perf time of a graph from records and predictions only, for
+     * callers that must not tune, such as threads of a parallel team, where
+     * kernels would be timed on one thread.
+     *
+     * @return nullopt if some operator has neither a record nor a confident
+     * prediction
+     */
+    std::optional<double> getKnownPerfTime(const Graph &graph) const;
     Blob allocBlob(size_t size);
     bool isCpu() const {
         return device == Device::CPU || device == Device::INTELCPU;
@@ -109,6 +128,7 @@ class RuntimeObj : public std::enable_shared_from_this<RuntimeObj> {
                                size_t bytes) const = 0;
     virtual string toString() const = 0;
 
+    Device getDevice() const { return device; }
     int getDeviceId() const { return deviceId; }
 
     virtual void initComm(const string &name, int worldSize, int rank) = 0;
@@ -129,6 +149,12 @@ class CpuRuntimeObj : public RuntimeObj {
 
     void run(const Graph &graph, bool tune = false,
              bool profiling = false) const override;
+    /**
+     * @brief Resolve the kernel, perf record and compute function of every op
+     * of the graph once. run replays the plan kept in the graph when neither
+     * tuning nor profiling, and recompiles it only once it is invalidated.
+     */
+    RunPlan compile(const Graph &graph) const;
 
     void copyBlobFromCPU(void *dst, const void *src,
                          size_t bytes) const override;
@@ -141,6 +167,8 @@ class CpuRuntimeObj : public RuntimeObj {
 };
 
 class NativeCpuRuntimeObj : public CpuRuntimeObj {
+    CpuAllocator allocator;
+
   public:
     NativeCpuRuntimeObj() : CpuRuntimeObj(Device::CPU) {}
 
@@ -149,12 +177,10 @@ class NativeCpuRuntimeObj : public CpuRuntimeObj {
             make_ref<NativeCpuRuntimeObj>();
         return instance;
     }
-    void dealloc(void *ptr) override { return free(ptr); };
+    void dealloc(void *ptr) override { return allocator.dealloc(ptr); };
 
-    void *alloc(size_t size) override {
-        return calloc((size + sizeof(uint64_t) - 1) / sizeof(uint64_t),
-                      sizeof(uint64_t));
-    };
+    void *alloc(size_t size) override { return allocator.alloc(size); };
+    CpuAllocator &getAllocator() { return allocator; }
     string toString() const override;
 };
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common.h"
+#include "cost_model.h"
 #include "graph.h"
 #include "mutator.h"
 
@@ -11,11 +12,14 @@ class SearchEngine {
   private:
     Runtime runtimeExec;
     Ref<Mutator> mutator;
+    CostModel costModel; // ranks the candidates of a partition
 
   public:
-    SearchEngine(Runtime _runtime, Ref<Mutator> _mutator) {
+    SearchEngine(Runtime _runtime, Ref<Mutator> _mutator,
+                 CostModel _costModel = make_ref<HeuristicCostModelObj>()) {
         runtimeExec = _runtime;
         mutator = _mutator;
+        costModel = _costModel;
     }
     ~SearchEngine() {}
 
@@ -23,12 +27,53 @@ class SearchEngine {
     size_t partitionThreshold =
         3;                  // cut nodes whose #in + #out >= partitionThreshold
     size_t GRAPH_SIZE = 16; // num of best graphs.
+    int numThreads = 0; // threads evaluating candidates, 0 for OpenMP default
+    bool useBeamSearch = false; // see setBeamSearch
+    size_t beamWidth = 16;      // replaces GRAPH_SIZE in beam search mode
 
   private: // Composed objects
     std::shared_ptr<Mutator> mutationEngine;
 
+  private: // Per-search cost cache, keyed by the guid of candidate graphs
+    std::unordered_map<UidBaseType, double> perfTimeCache;
+    std::unordered_map<UidBaseType, double> perfScoreCache;
+    size_t numCostEvaluations = 0;
+
   public:
     std::shared_ptr<Mutator> getMutationEngine() { return mutationEngine; };
+    /**
+     * @brief Number of graph cost evaluations (perf time queries on the
+     * runtime and cost model estimates) performed since the last run. Cache
+     * hits are not counted.
+     */
+    size_t getNumCostEvaluations() const { return numCostEvaluations; }
+    void setCostModel(CostModel model) {
+        IT_ASSERT(model != nullptr);
+        costModel = model;
+    }
+    CostModel getCostModel() const { return costModel; }
+    /**
+     * @brief Set the number of threads used to build and evaluate candidate
+     * graphs. The search result does not depend on it.
+     */
+    void setNumThreads(int n) {
+        IT_ASSERT(n >= 0);
+        numThreads = n;
+    }
+    /**
+     * @brief Enable or disable beam search. In beam search mode, a partial
+     * candidate is a chain of op sequences with an accumulated perf time
+     * instead of a materialized graph. Since the perf time of a graph is the
+     * sum of the perf time of its ops, extending a candidate costs a single
+     * addition. Only the final candidates are built into graphs.
+     *
+     * @param width The number of partial candidates kept at each step.
+     */
+    void setBeamSearch(bool enable, size_t width = 16) {
+        IT_ASSERT(width > 0);
+        useBeamSearch = enable;
+        beamWidth = width;
+    }
     struct GroupEdge {
         int v, next;
         GroupEdge() = delete;
@@ -38,6 +83,12 @@ class SearchEngine {
         std::shared_ptr<Graph> graph;
         double perf = INFINITY;
     };
+    struct BeamEntry { // a partial candidate in beam search
+        std::shared_ptr<const BeamEntry> prev; // the entry it extends
+        Graph segment;   // ops appended to the ops of prev
+        double cost = 0; // accumulated perf time of the whole chain
+    };
+    using Beam = std::vector<std::shared_ptr<const BeamEntry>>;
     class MetaGraph { // a graph of subgraphs, for searching.
       public:
         MetaGraph() {}
@@ -69,8 +120,35 @@ class SearchEngine {
                         std::unordered_set<uint64_t> &planSet);
     std::vector<Graph>
     searchMutation(const std::shared_ptr<MetaGraph> &metaGraph);
+    std::vector<Graph>
+    searchMutationBeam(const std::shared_ptr<MetaGraph> &metaGraph);
+    /**
+     * @brief Append each segment to each entry of the beam and keep the
+     * beamWidth cheapest results. A nullptr entry stands for an empty chain.
+     */
+    Beam extendBeam(const Beam &beam, const std::vector<Graph> &segments);
+    /**
+     * @brief Build the graph holding all ops of a beam entry.
+     */
+    Graph materialize(const std::shared_ptr<const BeamEntry> &entry);
 
     void printMetaGraph(Ref<SearchEngine::MetaGraph> metaGraph);
+    void clearCostCache();
+    // Cached wrappers of RuntimeObj::getPerfTime and CostModelObj::estimate
+    double getPerfTime(const Graph &graph);
+    double getPerfScore(const Graph &graph);
+    /**
+     * @brief Sort graphs by ascending cost. Each cost is computed (or fetched
+     * from the cache) once before sorting, instead of inside the comparator.
+     */
+    void sortByCost(std::vector<Graph> &graphs,
+                    double (SearchEngine::*cost)(const Graph &));
+    /**
+     * @brief Build a graph for each op list, allocate its memory and evaluate
+     * its perf time in parallel. Graphs are returned in the order of
+     * `opLists`, and their perf time is stored in the cost cache.
+     */
+    std::vector<Graph> buildCandidates(const std::vector<OpVec> &opLists);
     /**
      * @brief Check whether a multi-brach graph can be merged into a single
      * branch.
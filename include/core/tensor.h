@@ -80,6 +80,7 @@ class TensorObj : public TensorBaseObj {
     void save(std::string file_path);
 
     void copyin(const void *ptr, size_t size) {
+        detachData();
         runtime->copyBlobFromCPU(getRawDataPtr<void *>(), ptr, size);
     }
     void copyout(void *ptr, size_t size) const {
@@ -119,9 +120,15 @@ class TensorObj : public TensorBaseObj {
     // FIXME: std::fucntion copies the generator instead of passing it by ref.
     // Thus the internal state of generator cannot be updated.
     void setData(
-        std::function<void(void *, size_t, DataType)> const &generator) const;
+        std::function<void(void *, size_t, DataType)> const &generator);
 
     void setDataBlob(const Blob &blob);
+    // Whether the data blob is shared with a copy-on-write clone.
+    bool isDataShared() const { return data && data.use_count() > 1; }
+    // Give this tensor a private copy of a blob shared with its clones. Called
+    // by every TensorObj method that writes the data; kernels write outputs
+    // only after GraphObj::dataMalloc has bound them to fresh memory.
+    void detachData();
 
     Tensor clone() const {
         auto obj = make_ref<TensorObj>(*this);
@@ -130,15 +137,27 @@ class TensorObj : public TensorBaseObj {
         obj->source.reset();
         return obj;
     }
-    Tensor clone(Runtime runtime) const {
+    /**
+     * @brief Clone a tensor onto `runtime`.
+     *
+     * On the same runtime the clone shares a blob that owns its memory
+     * copy-on-write. Other data, such as that in the arena of a graph, which
+     * lives only as long as the graph, is copied, as is data across runtimes.
+     * With `cloneData` false only the shape and type are cloned.
+     */
+    Tensor clone(Runtime runtime, bool cloneData = true) const {
         auto obj = make_ref<TensorObj>(*this);
         obj->runtime = runtime;
         obj->freeData();
         obj->targets.clear();
         obj->source.reset();
-        if (hasData()) {
-            obj->dataMalloc();
-            obj->copyData(this);
+        if (cloneData && hasData()) {
+            if (runtime == this->runtime && data->isOwned()) {
+                obj->data = data;
+            } else {
+                obj->dataMalloc();
+                obj->copyData(this);
+            }
         }
         return obj;
     }
@@ -0,0 +1,60 @@
+#pragma once
+#include "core/common.h"
+#include "core/op_type.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+namespace infini {
+
+// One op executed by a traced run
+struct TraceEvent {
+    // op type and guid, e.g. "Matmul#12"
+    string name;
+    OpType type;
+    // name of the kernel in KernelRegistry
+    string kernel;
+    // microseconds since the tracer was created or cleared
+    double start, end;
+    // small id of the executing thread, stable for the thread's lifetime
+    int thread;
+    // bytes of all inputs and outputs
+    size_t bytes;
+    // getComputeTime of the op, the cost model's estimate in seconds
+    double estimatedTime;
+};
+
+/**
+ * @brief Collects a TraceEvent per op of CpuRuntimeObj::run while enabled,
+ * and exports them as Chrome trace JSON (chrome://tracing, Perfetto) or CSV.
+ * Disabled tracing costs one flag check per run.
+ */
+class Tracer {
+    std::atomic<bool> enabled{false};
+    std::chrono::steady_clock::time_point epoch =
+        std::chrono::steady_clock::now();
+    mutable std::mutex mutex;
+    vector<TraceEvent> events;
+
+  public:
+    static Tracer &getInstance() {
+        static Tracer instance;
+        return instance;
+    }
+
+    void setEnabled(bool enable) { enabled = enable; }
+    bool isEnabled() const { return enabled; }
+    // Drop the events and restart the clock. Not to be called during a run
+    void clear();
+
+    // Microseconds since the tracer was created or cleared
+    double now() const;
+    static int threadId();
+    void record(TraceEvent event);
+    vector<TraceEvent> getEvents() const;
+
+    void exportChromeTrace(const string &path) const;
+    void exportCsv(const string &path) const;
+};
+
+} // namespace infini
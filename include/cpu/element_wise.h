@@ -0,0 +1,95 @@
+#pragma once
+#include "core/common.h"
+
+namespace infini {
+
+/**
+ * @brief The iteration space of a broadcast element-wise op.
+ *
+ * Inputs are broadcast to the rank of the output, dimensions of size 1 are
+ * dropped, and adjacent dimensions that are contiguous in every operand are
+ * collapsed into one. `strides[k][d]` is the element stride of input k along
+ * dims[d], 0 if input k is broadcast along it. The output is contiguous.
+ */
+struct ElementWiseLayout {
+    Shape dims;
+    vector<vector<size_t>> strides;
+
+    ElementWiseLayout(const Shape &outDims, const vector<Shape> &inputDims);
+    size_t size() const;
+};
+
+namespace elementwise {
+// Smaller ops stay on the calling thread
+constexpr size_t ParallelThreshold = 1 << 15;
+// The innermost dimension is split into blocks of at most this many elements,
+// so that a contiguous op still spreads over all threads
+constexpr size_t BlockSize = 1 << 14;
+} // namespace elementwise
+
+/**
+ * @brief out[i] = f(in[i]) over n contiguous elements. f is inlined into a
+ * SIMD loop, so each (op, dtype) pair gets its own kernel.
+ */
+template <typename T, typename F>
+void cpuUnaryMap(const T *in, T *out, size_t n, F f) {
+#pragma omp parallel for simd if (n >= elementwise::ParallelThreshold)
+    for (size_t i = 0; i < n; ++i)
+        out[i] = f(in[i]);
+}
+
+/**
+ * @brief out = f(a, b) with a and b broadcast as described by `layout`.
+ *
+ * The collapsed outer dimensions and blocks of the innermost one are spread
+ * over OpenMP threads. Each block runs one of the unit-stride, broadcast
+ * scalar or generic strided inner loops, with f inlined.
+ */
+template <typename T, typename F>
+void cpuBinaryMap(const ElementWiseLayout &layout, const T *a, const T *b,
+                  T *out, F f) {
+    const int rank = layout.dims.size();
+    const size_t inner = layout.dims.back();
+    const size_t blocksPerRow =
+        (inner + elementwise::BlockSize - 1) / elementwise::BlockSize;
+    const size_t tasks = layout.size() / inner * blocksPerRow;
+    const auto &stridesA = layout.strides[0], &stridesB = layout.strides[1];
+    const size_t sa = stridesA.back(), sb = stridesB.back();
+
+#pragma omp parallel for if (layout.size() >= elementwise::ParallelThreshold)
+    for (size_t task = 0; task < tasks; ++task) {
+        const size_t row = task / blocksPerRow;
+        const size_t begin = task % blocksPerRow * elementwise::BlockSize;
+        const size_t len = std::min(elementwise::BlockSize, inner - begin);
+        size_t offA = begin * sa, offB = begin * sb;
+        size_t rest = row;
+        for (int d = rank - 2; d >= 0; --d) {
+            const size_t idx = rest % layout.dims[d];
+            rest /= layout.dims[d];
+            offA += idx * stridesA[d];
+            offB += idx * stridesB[d];
+        }
+        const T *pa = a + offA, *pb = b + offB;
+        T *pc = out + row * inner + begin;
+        if (sa == 1 && sb == 1) {
+#pragma omp simd
+            for (size_t i = 0; i < len; ++i)
+                pc[i] = f(pa[i], pb[i]);
+        } else if (sa == 1 && sb == 0) {
+            const T vb = *pb;
+#pragma omp simd
+            for (size_t i = 0; i < len; ++i)
+                pc[i] = f(pa[i], vb);
+        } else if (sa == 0 && sb == 1) {
+            const T va = *pa;
+#pragma omp simd
+            for (size_t i = 0; i < len; ++i)
+                pc[i] = f(va, pb[i]);
+        } else {
+            for (size_t i = 0; i < len; ++i)
+                pc[i] = f(pa[i * sa], pb[i * sb]);
+        }
+    }
+}
+
+} // namespace infini
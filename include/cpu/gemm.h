@@ -0,0 +1,47 @@
+#pragma once
+#include "core/common.h"
+#include "core/op_type.h"
+#include <cmath>
+
+namespace infini {
+
+/**
+ * @brief Batched C = op(A) * op(B) of M x K and K x N matrices, with the
+ * packed, cache-blocked GEMM of the native CPU runtime.
+ *
+ * Matrix b of the batch starts at A + offsetsA[b], B + offsetsB[b] and
+ * C + offsetsC[b], and lda, ldb and ldc are the row strides of the stored
+ * (not transposed) matrices. If set, `epilogue(b, i0, j0, mc, nc)` is called
+ * once a tile of rows [i0, i0 + mc) and columns [j0, j0 + nc) of C is done.
+ * Tiles are computed by OpenMP threads.
+ */
+template <typename T>
+void cpuGemm(int batch, int M, int N, int K, const T *A,
+             const size_t *offsetsA, int lda, bool transA, const T *B,
+             const size_t *offsetsB, int ldb, bool transB, T *C,
+             const size_t *offsetsC, int ldc,
+             const std::function<void(int, int, int, int, int)> &epilogue =
+                 nullptr);
+
+/**
+ * @brief The fused activation of MatMul and Conv. LeakyRelu uses the ONNX
+ * default alpha of 0.01, since ActType carries no alpha.
+ */
+template <typename T> inline T activate(T x, ActType act) {
+    switch (act) {
+    case ActType::None:
+        return x;
+    case ActType::Relu:
+        return x > T(0) ? x : T(0);
+    case ActType::LeakyRelu:
+        return x > T(0) ? x : T(0.01 * x);
+    case ActType::Sigmoid:
+        return T(1 / (1 + std::exp(-double(x))));
+    case ActType::Tanh:
+        return T(std::tanh(double(x)));
+    }
+    IT_TODO_HALT();
+    return x;
+}
+
+} // namespace infini
@@ -16,8 +16,9 @@ class CudaKernelWithoutConfig : public Kernel {
     virtual PerfRecord tune(const Operator &op,
                             const RuntimeObj *_context) const {
         auto context = dynamic_cast<const CudaRuntimeObj *>(_context);
-        return make_ref<PerfRecordObj>(timeit([&]() { compute(op, _context); },
-                                              [&]() { context->sync(); }));
+        return make_ref<PerfRecordObj>(
+            timeitStats([&]() { compute(op, _context); },
+                        [&]() { context->sync(); }));
     }
 };
 
@@ -18,8 +18,9 @@ class MklKernelWithoutConfig : public Kernel {
     virtual PerfRecord tune(const Operator &op,
                             const RuntimeObj *_context) const override {
         auto context = dynamic_cast<const MklRuntimeObj *>(_context);
-        return make_ref<PerfRecordObj>(timeit([&]() { compute(op, _context); },
-                                              [&]() { context->sync(); }));
+        return make_ref<PerfRecordObj>(
+            timeitStats([&]() { compute(op, _context); },
+                        [&]() { context->sync(); }));
     }
 
   protected:
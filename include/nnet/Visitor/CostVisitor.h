@@ -0,0 +1,41 @@
+#pragma once
+#include "nnet/visitor.h"
+
+namespace nnet {
+
+/**
+ * @brief A lower bound of the time to run a derived expression, in ms, for
+ * best-first derivation, on a roofline with the memory bandwidth of
+ * NMutator::memboundTime.
+ *
+ * Each matched routine reads its inputs, writes its output and does its
+ * multiply-adds, the generated code of ElementWise routines at a lower
+ * throughput than library kernels. The stages left to match write the output,
+ * read each tensor they use and do the reduction of the root stage, at best
+ * as a library kernel.
+ */
+class CostVisitor : public ExprTreeVisitor {
+  private:
+    static constexpr double bandwidth = double(200) * 1024 * 1024 * 1024;
+    static constexpr double kernelFlops = 10e12, elementWiseFlops = 1e12;
+    // tensors whose routine, or whose read by the unmatched stages, is
+    // already counted
+    std::unordered_set<string> computed, read;
+    bool inUnmatched = false;
+    int64_t unmatchedElements = 0;
+    double cost = 0;
+
+  public:
+    CostVisitor(int _verobse = 0) : ExprTreeVisitor(1, 1, 1, 1, _verobse) {}
+    void visit_(const Tensor &c) override;
+    double estimate(const Expr &root);
+    // Time to move nElements floats through memory, in ms
+    static double memoryTime(int64_t nElements);
+
+  private:
+    static double routineTime(const Tensor &output);
+    // Flops of the reduction of a stage, 0 without sum iterators
+    static double getReductionFlops(const RangeOp &range);
+};
+
+} // namespace nnet
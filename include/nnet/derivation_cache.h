@@ -0,0 +1,39 @@
+#pragma once
+#include "common.h"
+#include "expr.h"
+#include <optional>
+
+namespace nnet {
+
+/**
+ * @brief An on-disk cache of derivation results, shared across processes.
+ *
+ * A key describes the workload and the derivation settings. Its entry is a
+ * directory named by the hash of the key, holding an index with the full key
+ * and one Serializer file per candidate expression. Entries are written under
+ * a temporary name and renamed, so readers never see a partial entry.
+ */
+class DerivationCache {
+    // Bump when the entry layout or the derivation output changes
+    static constexpr int VERSION{1};
+    string dir;
+
+  public:
+    explicit DerivationCache(const string &dir);
+
+    /**
+     * @brief The candidates stored for the key.
+     *
+     * @return nullopt if there is no entry, or it is unreadable, of another
+     * version or of a colliding key, or the directory cannot be accessed
+     */
+    std::optional<VecExpr> load(const string &key) const;
+    // Store the candidates for the key. An existing entry is kept, and a
+    // failure to write is ignored.
+    void store(const string &key, const VecExpr &candidates) const;
+
+  private:
+    string getEntryPath(const string &key) const;
+};
+
+} // namespace nnet
@@ -3,7 +3,12 @@
 #include "expr.h"
 #include "iterator_table.h"
 #include "routine.h"
+#include <array>
+#include <atomic>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <mutex>
 #include <sstream>
 #include <unordered_set>
 
@@ -39,6 +44,21 @@ class MultiFormulas {
     // }
 };
 
+// A set of formula hashes, safe to be inserted into by concurrent tasks
+class VisitedSet {
+    static constexpr int nShards = 64;
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_set<HashType> hashes;
+    };
+    std::array<Shard, nShards> shards;
+
+  public:
+    // Return false if the hash is already in the set
+    bool insert(HashType hash);
+    size_t size() const;
+};
+
 class Derivator {
   public:
     enum class LogMode { Normal, DumpFristCandiate, NoLog };
@@ -47,8 +67,8 @@ class Derivator {
   private:
     list<Formula> candidates;
     const int maxDepth;
-    int nIteratorNames = 0;
-    int nTensorNames = 0;
+    std::atomic<int> nIteratorNames = 0;
+    std::atomic<int> nTensorNames = 0;
     vector<vector<int>> rulesOverall;
     enum class Strategy { DFS, Rule, RuleAndDFS } searchStrategy;
     LogMode logMode;
@@ -62,17 +82,77 @@ class Derivator {
 
     vector<int> cntAppliedRules;
     int cntRule3 = 0;
-    std::unordered_set<HashType> visited;
+    VisitedSet visited;
     VecExpr intermediateStates;
     vector<string> ruleStates, ruleMsgs;
     int cntStates = 0;   // the number of intermediate states
     int searchState = 0; // search state in guided search
 
+    // States shallower than spawnDepth are derived by forks in OpenMP tasks.
+    // 0 for serial search.
+    int spawnDepth = 0;
+    // The derivator starting the search, whose names and visited set are
+    // shared by all forks
+    Derivator *searchRoot = this;
+    // Forks spawned by this derivator and the number of its candidates when
+    // each was spawned, to merge the candidates in the serial order
+    vector<std::pair<size_t, std::unique_ptr<Derivator>>> forks;
+
+    // A state waiting to be derived in best-first search, with the search
+    // context of the rule application reaching it
+    struct PendingState {
+        // lower bound of the cost of its candidates by CostVisitor
+        double bound;
+        int depth;
+        size_t order;
+        Expr root;
+        int bfsDepth;
+        int searchState;
+        RoutineType targetOp;
+        vector<int> cntAppliedRules;
+        VecExpr intermediateStates;
+        vector<string> ruleStates, ruleMsgs;
+    };
+    // 0 for depth-first search
+    double bestFirstSlack = 0;
+    double bestCost = std::numeric_limits<double>::infinity();
+    // A heap of the states to derive in best-first search
+    vector<PendingState> frontier;
+    size_t nPendingStates = 0;
+    int cntPrunedStates = 0;
+
   public:
     Derivator(int maxDepth = 8, bool enableHashPruning = true,
               LogMode mode = LogMode::NoLog,
               PassMode passMode = PassMode::Debug);
     void search(Formula &origin, int depth);
+    /**
+     * @brief Derive in parallel. The state reached by each rule application
+     * shallower than spawnDepth is derived by a fork of the derivator, with
+     * its own state stacks and candidates, in an OpenMP task. The candidates
+     * of forks are merged in the order serial search finds them.
+     *
+     * A state is pruned only if it was visited with the same depth and search
+     * context, so the candidates do not depend on the order in which tasks
+     * run, and are those of serial search, which prunes on the same key, up
+     * to the names of new iterators and tensors.
+     *
+     * @param spawnDepth 0 for serial search
+     */
+    void setParallelSearch(int spawnDepth);
+    /**
+     * @brief Derive best-first. A state reached by a rule application waits
+     * in a frontier, and the state with the lowest bound of cost by
+     * CostVisitor is derived next, deepest first among equal bounds. A state
+     * is dropped once its bound exceeds the cost of the best candidate found
+     * times the slack, since none of its candidates can beat it. Candidates
+     * are thus found cheapest first.
+     *
+     * @param slack At least 1 to keep the candidates within the slack of the
+     * best one, 0 for depth-first search
+     */
+    void setBestFirstSearch(double slack);
+    int getNumPrunedStates() const { return cntPrunedStates; }
     void ruleBasedDFS(Formula &origin, int depth, vector<int> _rules,
                       map<int, vector<Var>> _substituteRules = {},
                       bool searchAfterRules = false);
@@ -93,6 +173,23 @@ class Derivator {
   private:
     void dfs(Formula &origin, int depth);
     void ruleBasedDerivate(Formula &origin, int depth);
+    // Derive the state reached by a rule application at `depth`
+    void deriveNext(Formula &origin, int depth);
+    // Run `search` on a team of threads if the search is parallel
+    void runSearch(const std::function<void()> &search);
+    // Derive `origin` by a fork in a new task
+    void spawn(const Formula &origin, int depth);
+    std::unique_ptr<Derivator> fork() const;
+    // Merge the candidates and statistics of the forks once all tasks finish
+    void mergeForks();
+    // Put the state reached by a rule application at `depth` in the frontier
+    void defer(Formula &origin, int depth);
+    // Derive the states in the frontier best-first until it is empty
+    void deriveFrontier();
+    // Order of the frontier heap, whose top is derived first
+    static bool isDerivedLater(const PendingState &lhs,
+                               const PendingState &rhs);
+    HashType getVisitedKey(HashType formulaHash, int depth) const;
 
     void rule1VariableSplit(Formula &origin, int depth, Expr &rCur);
     void rule2VariableMerging(Formula &origin, int depth, Expr &rCur);
@@ -0,0 +1,40 @@
+#pragma once
+#include "common.h"
+#include "expr.h"
+
+namespace nnet {
+
+/**
+ * @brief Checks that expressions compute the same output, on random integer
+ * inputs at a random sample of output positions.
+ *
+ * The sample is blocks of consecutive positions, the same for every
+ * expression, including the first and the last block. Each expression is
+ * compiled once to a LoopNest, which evaluates a block in one traversal, and
+ * threads take blocks. Checking stops at the first mismatching block.
+ */
+class EquivalenceChecker {
+    int64_t nSamples;
+    uint64_t seed;
+
+  public:
+    // Consecutive positions evaluated together
+    static constexpr int64_t blockSize = 128;
+
+    explicit EquivalenceChecker(int64_t nSamples = 4096, uint64_t seed = 0);
+
+    /**
+     * @brief Whether the RangeOps in exprs compute the output of exprs[0].
+     *
+     * Expressions reading other tensors than exprs[0], such as outputs of
+     * matched routines, are skipped, as are expressions that are not
+     * RangeOps.
+     */
+    bool check(const VecExpr &exprs) const;
+
+  private:
+    // Starts of the sampled blocks of an output, in increasing order
+    vector<int64_t> sampleBlocks(int64_t outputSize) const;
+};
+
+} // namespace nnet
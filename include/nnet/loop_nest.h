@@ -0,0 +1,131 @@
+#pragma once
+#include "common.h"
+#include "expr.h"
+#include <optional>
+
+namespace nnet {
+
+/**
+ * @brief A RangeOp lowered to loop nests over raw buffers, to evaluate the
+ * expression of a MemBound operator without the tree-walking Interpreter.
+ *
+ * Each RangeOp in the expression becomes a stage: its iterators get slots in
+ * an int array and its summand becomes a postfix program. Index expressions
+ * affine in the iterators are advanced by one addition per loop step instead
+ * of being recomputed, and a bound is only checked where interval analysis
+ * of the iterator ranges cannot prove it. Other index expressions, with / or
+ * %, are evaluated from the slots. A subscripted RangeOp is evaluated in
+ * place as a nested stage.
+ *
+ * As in padding, out-of-range reads of tensors and nested stages are zero.
+ */
+class LoopNest {
+    enum class InstType {
+        Const,
+        Iter,
+        Load,
+        Stage,
+        Add,
+        Sub,
+        Mul,
+        Div,
+        Mod,
+        Relu,
+        Tanh,
+        PRelu
+    };
+    struct Inst {
+        InstType type;
+        // value of Const, slot of Iter, access of Load, stage of Stage
+        int arg = 0;
+    };
+    // An index expression of a stage. Affine ones are kept up to date by the
+    // loops, others are programs of Const, Iter and int arithmetic.
+    struct IndexRef {
+        bool affine;
+        int id;
+    };
+    struct Affine {
+        int64_t constant = 0;
+        // slot and coefficient
+        vector<pair<int, int64_t>> terms;
+    };
+    struct Access {
+        int input;
+        // offset in the input if all indices are affine, else unused
+        IndexRef offset;
+        // affine indices that must be in [0, bound) for a nonzero read
+        vector<pair<IndexRef, int>> checks;
+        // indices, strides and shape if some index is not affine
+        vector<IndexRef> dims;
+        vector<int64_t> strides;
+        vector<int> shape;
+    };
+    struct Stage {
+        int parent;
+        // Loops, outermost first: the output loops and then the sum loops of
+        // the root, the sum loops of a nested stage
+        vector<int> loopSlots;
+        vector<Range> loopRanges;
+        int nOutputLoops;
+        // Slots of the loop iterators of a nested stage, their ranges, and
+        // the indices in the parent stage that set them
+        vector<int> boundSlots;
+        vector<Range> boundRanges;
+        vector<IndexRef> bindings;
+        vector<Affine> affines;
+        // increments of the affines per step of each loop, and the decrement
+        // when the loop wraps around, indexed by loop * affines + affine
+        vector<int64_t> steps, wraps;
+        vector<vector<Inst>> generics;
+        vector<Access> accesses;
+        vector<Inst> program;
+        // whether some sum loop is empty, making every element zero
+        bool empty = false;
+    };
+
+    vector<Stage> stages;
+    // name of each input tensor, by index
+    vector<string> inputNames;
+    vector<Range> slotRanges;
+    // iterators in scope while compiling, innermost last
+    vector<pair<string, int>> scope;
+    int64_t outputSize;
+    int maxStackSize = 0, maxIndexStackSize = 0;
+
+    template <typename T> class Evaluator;
+
+  public:
+    // Compile `range`, whose tensors are named as `inputs`
+    LoopNest(const RangeOp &range, const vector<Tensor> &inputs);
+
+    int64_t getOutputSize() const { return outputSize; }
+    // Evaluate all outputs in the row-major order of the loop iterators, with
+    // the data of each input in the order of the constructor.
+    // Instantiated for float, int32_t and uint32_t.
+    template <typename T>
+    void run(const vector<const T *> &inputs, T *output) const;
+    // Evaluate the outputs [begin, end) into output[0, end - begin) on the
+    // calling thread, for callers sampling the output in parallel
+    template <typename T>
+    void run(const vector<const T *> &inputs, int64_t begin, int64_t end,
+             T *output) const;
+
+  private:
+    int addStage(const RangeOp &range, int parent,
+                 const vector<IndexRef> &bindings);
+    int addSlot(const Var &var, const Range &range);
+    void compileValue(int stage, const Expr &expr, int depth);
+    void compileAccess(int stage, const Subscript &subscript);
+    IndexRef compileIndex(int stage, const Expr &expr);
+    int addAffine(int stage, Affine affine);
+    static void addTerms(Affine &lhs, const Affine &rhs, int64_t scale);
+    std::optional<Affine> toAffine(const Expr &expr) const;
+    int compileGeneric(const Expr &expr, vector<Inst> &program,
+                       int depth) const;
+    int findSlot(const string &name) const;
+    // Bounds of the values of an affine over the slot ranges, inclusive
+    pair<int64_t, int64_t> getInterval(const Affine &affine) const;
+};
+
+} // namespace nnet
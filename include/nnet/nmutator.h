@@ -2,6 +2,10 @@
 #include "core/mutator.h"
 #include "nnet/expr.h"
 
+namespace nnet {
+class DerivationCache;
+} // namespace nnet
+
 namespace infini {
 
 class NMutator : public Mutator {
@@ -17,6 +21,8 @@ class NMutator : public Mutator {
     const double bandwidth = double(200) * 1024 * 1024 * 1024;
     // If in RuleBased mode, use derivationRules in derivator
     const std::vector<int> derivationRules;
+    // Derivation results of previous runs, keyed by the op workload
+    std::unique_ptr<nnet::DerivationCache> derivationCache;
 
   public:
     NMutator(Mode mode = Mode::Normal);
@@ -27,13 +33,22 @@ class NMutator : public Mutator {
     void setToNaiveMembound();
 
     void setMaxDepth(int _maxDepth) { maxDepth = _maxDepth; }
+    // See Derivator::setBestFirstSearch
+    void setBestFirstSearch(double slack) { bestFirstSlack = slack; }
+    // Reuse the candidates derived for the same workload and settings, by
+    // this or any other process sharing the directory
+    void setDerivationCache(const std::string &dir);
     long long cntStates = 0;
     long long cntCandidates = 0;
+    long long cntCacheHits = 0;
 
   private:
     int maxDepth = 8;
+    double bestFirstSlack = 0;
     nnet::Expr opToExpression(Operator op);
     void runSingleOp(Graph in_graph, std::vector<Graph> &out_graphs);
+    // Key of the derivation of op in DerivationCache
+    std::string getDerivationKey(const Operator &op) const;
 
     /**
      * @brief Test helper. Converting a single OP to Membound Op for
@@ -28,6 +28,7 @@ from typing import Dict, List, Any, Tuple, Sequence, Union, Optional
 from functools import reduce
 from onnxsim import simplify
 import copy
+import os
 import warnings
 import numpy as np
 
@@ -44,7 +45,18 @@ class OnnxStub:
         runtime,
         use_naive_allocator: bool = False,
         matmul_compute_type: str = "default",
+        mem_plan_strategy=backend.MemPlanStrategy.Online,
+        inplace_planning: bool = True,
+        weight_file: Optional[str] = None,
+        inter_op_parallel: bool = False,
     ):
+        """
+        `weight_file` caches the weights in the native layout of the weight
+        arena. If the file exists the weights are mapped from it instead of
+        copied from `model`, which may then be loaded with
+        `load_external_data=False`; otherwise it is written once the weights
+        are copied in.
+        """
         # We use some user-defined operators for distributed inference
         try:
             # onnx simplifier performs inplace simplify
@@ -67,6 +79,12 @@ class OnnxStub:
         # except:
         #     warnings.warn("infer_shapes failed.")
         self.handler = backend.GraphHandler(runtime)
+        self.handler.set_mem_plan_strategy(mem_plan_strategy)
+        self.handler.set_inplace_planning(inplace_planning)
+        self.handler.set_inter_op_parallel(inter_op_parallel)
+        map_weights = weight_file is not None and os.path.exists(weight_file)
+        if map_weights:
+            self.handler.set_weight_file(weight_file)
 
         # 处理重名和匿名算子
         names = {}
@@ -1122,7 +1140,10 @@ class OnnxStub:
                 #     obj.copyin_float16(_parse_data_fp16(tensor))
                 # else:
                 #     assert False, "Unsupported Tensor Type: {}".format(tensor.data_type)
-                obj.copyin_numpy(to_array(tensor))
+                if not map_weights:
+                    obj.copyin_numpy(to_array(tensor))
+        if weight_file is not None and not map_weights:
+            self.handler.save_weights(weight_file)
 
         for name, obj in tensors.items():
             self.tensors[name] = obj
@@ -4,8 +4,9 @@
 namespace infini {
 
 BlobObj::~BlobObj() {
-    // Avoid cycled inclusion
-    // destruction is performed in LazyAllocator
+    // Arena-backed blobs are released by their LazyAllocator
+    if (owned)
+        runtime->dealloc(ptr);
 }
 
 } // namespace infini
@@ -1,6 +1,11 @@
 #include "core/common.h"
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <functional>
+#ifdef __linux__
+#include <sched.h>
+#endif
 
 namespace infini {
 
@@ -21,6 +26,97 @@ double timeit(const std::function<void()> &func,
            timingRounds;
 }
 
+namespace {
+// Linear interpolation between the closest ranks of sorted `v`
+double percentile(const vector<double> &v, double p) {
+    double rank = p * (v.size() - 1);
+    size_t lo = static_cast<size_t>(rank);
+    size_t hi = std::min(lo + 1, v.size() - 1);
+    return v[lo] + (rank - lo) * (v[hi] - v[lo]);
+}
+
+// Pins the calling thread to a CPU and restores its affinity on destruction
+class CpuPinGuard {
+#ifdef __linux__
+    cpu_set_t oldMask;
+    bool pinned = false;
+#endif
+
+  public:
+    explicit CpuPinGuard(int cpu) {
+#ifdef __linux__
+        if (cpu < 0 || sched_getaffinity(0, sizeof(oldMask), &oldMask) != 0)
+            return;
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpu, &mask);
+        pinned = sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#endif
+    }
+    ~CpuPinGuard() {
+#ifdef __linux__
+        if (pinned)
+            sched_setaffinity(0, sizeof(oldMask), &oldMask);
+#endif
+    }
+};
+} // namespace
+
+TimingStats timeitStats(const std::function<void()> &func,
+                        const std::function<void(void)> &sync,
+                        const TimingConfig &config) {
+    IT_ASSERT(config.minRounds >= 1 && config.maxRounds >= config.minRounds);
+    CpuPinGuard pin(config.pinCpu);
+    vector<char> flushBuffer(config.flushCache ? config.flushBytes : 0);
+    for (int i = 0; i < config.warmupRounds; ++i)
+        func();
+    if (sync)
+        sync();
+
+    vector<double> samples;
+    double total = 0, sumSquares = 0;
+    while (static_cast<int>(samples.size()) < config.maxRounds) {
+        // Touch every cache line of a buffer larger than the caches
+        for (size_t i = 0; i < flushBuffer.size(); i += 64)
+            ++flushBuffer[i];
+        auto start = std::chrono::high_resolution_clock::now();
+        func();
+        if (sync)
+            sync();
+        auto end = std::chrono::high_resolution_clock::now();
+        double t = std::chrono::duration<double, std::milli>(end - start)
+                       .count();
+        samples.emplace_back(t);
+        total += t;
+        sumSquares += t * t;
+
+        int n = samples.size();
+        if (n < config.minRounds)
+            continue;
+        if (total >= config.maxTime)
+            break;
+        double mean = total / n;
+        double var = std::max(0.0, sumSquares / n - mean * mean) * n /
+                     std::max(n - 1, 1);
+        double ci = 1.96 * std::sqrt(var / n);
+        if (ci <= config.relativeCI * mean)
+            break;
+    }
+
+    TimingStats stats;
+    stats.rounds = samples.size();
+    stats.mean = total / stats.rounds;
+    double var = 0;
+    for (double t : samples)
+        var += (t - stats.mean) * (t - stats.mean);
+    stats.stddev = std::sqrt(var / std::max(stats.rounds - 1, 1));
+    std::sort(samples.begin(), samples.end());
+    stats.median = percentile(samples, 0.5);
+    stats.p10 = percentile(samples, 0.1);
+    stats.p90 = percentile(samples, 0.9);
+    return stats;
+}
+
 // transform vector<int> to vector<int64_t>
 std::vector<int64_t> castTo64(std::vector<int> const &v32) {
     if (v32.size() == 0) {
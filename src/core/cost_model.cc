@@ -0,0 +1,99 @@
+#include "core/cost_model.h"
+#include "operators/element_wise.h"
+#include "operators/matmul.h"
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace infini {
+
+double CostModelObj::estimate(const Graph &graph) const {
+    double cost = 0;
+    for (const auto &op : graph->getOperators())
+        cost += estimate(op);
+    return cost;
+}
+
+double HeuristicCostModelObj::estimate(const Operator &op) const {
+    // 计算时间权重最大，内存成本次之，并行度可以提高性能所以为负权重
+    return op->getComputeTime() + 0.5 * op->getMemoryCost() -
+           0.2 * op->getParallelism();
+}
+
+RooflineCostModelObj::RooflineCostModelObj(double peakFlops,
+                                           double memBandwidth, int numCores)
+    : peakFlops(peakFlops), memBandwidth(memBandwidth), numCores(numCores) {
+    IT_ASSERT(peakFlops > 0 && memBandwidth > 0 && numCores > 0);
+}
+
+double RooflineCostModelObj::estimate(const Operator &op) const {
+    double flops = op->getComputeTime() * nominalFlops;
+    size_t elemSize =
+        op->getInputs().empty() ? 4 : op->getInputs(0)->getDType().getSize();
+    double bytes = op->getMemoryCost() * elemSize;
+    // An operator can not use more cores than its parallelism
+    double cores = std::clamp(op->getParallelism(), 1.0, double(numCores));
+    double computeTime = flops / (peakFlops * cores / numCores);
+    double memoryTime = bytes / memBandwidth;
+    return std::max(computeTime, memoryTime);
+}
+
+string RooflineCostModelObj::toString() const {
+    std::ostringstream oss;
+    oss << "RooflineCostModel(peakFlops=" << peakFlops
+        << ", memBandwidth=" << memBandwidth << ", numCores=" << numCores
+        << ")";
+    return oss.str();
+}
+
+namespace {
+// Execution time of a graph in seconds
+double timeGraph(const Graph &graph) {
+    auto runtime = graph->getRuntime();
+    return timeit([&]() { runtime->run(graph); }, {}, 1, 3) / 1000;
+}
+
+// Fit time = workload / throughput by least squares through the origin, and
+// return the throughput.
+double fitThroughput(const vector<pair<double, double>> &samples) {
+    double wt = 0, ww = 0;
+    for (auto &[workload, time] : samples) {
+        wt += workload * time;
+        ww += workload * workload;
+    }
+    IT_ASSERT(wt > 0);
+    return ww / wt;
+}
+} // namespace
+
+Ref<RooflineCostModelObj> RooflineCostModelObj::calibrate(Runtime runtime) {
+    int numCores = 1;
+#ifdef _OPENMP
+    numCores = omp_get_max_threads();
+#endif
+    // Matmul of these sizes has enough parallelism to occupy all cores
+    vector<pair<double, double>> computeSamples;
+    for (int n : {64, 128, 192}) {
+        Graph g = make_ref<GraphObj>(runtime);
+        auto a = g->addTensor({n, n}), b = g->addTensor({n, n});
+        auto op = g->addOp<MatmulObj>(a, b, nullptr);
+        g->dataMalloc();
+        computeSamples.emplace_back(op->getComputeTime() * nominalFlops,
+                                    timeGraph(g));
+    }
+    vector<pair<double, double>> memorySamples;
+    for (int n : {1 << 16, 1 << 18, 1 << 20}) {
+        Graph g = make_ref<GraphObj>(runtime);
+        auto a = g->addTensor(Shape{n}), b = g->addTensor(Shape{n});
+        auto op = g->addOp<AddObj>(a, b, nullptr);
+        g->dataMalloc();
+        memorySamples.emplace_back(
+            op->getMemoryCost() * a->getDType().getSize(), timeGraph(g));
+    }
+    return make_ref<RooflineCostModelObj>(fitThroughput(computeSamples),
+                                          fitThroughput(memorySamples),
+                                          numCores);
+}
+
+} // namespace infini
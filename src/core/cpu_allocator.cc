@@ -0,0 +1,129 @@
+#include "core/cpu_allocator.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace infini {
+
+// Size of the default huge page on x86-64 and aarch64
+constexpr size_t hugePageSize = 2 << 20;
+
+static size_t roundUp(size_t size, size_t unit) {
+    return (size + unit - 1) / unit * unit;
+}
+
+void *CpuAllocator::map(size_t bytes, bool &hugeTlb) {
+    void *ptr = MAP_FAILED;
+    hugeTlb = false;
+    if (config.hugePages == HugePageMode::Explicit) {
+        ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        hugeTlb = ptr != MAP_FAILED;
+        if (!hugeTlb)
+            stats.hugeTlbFallbacks++;
+    }
+    if (ptr == MAP_FAILED) {
+        ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        IT_ASSERT(ptr != MAP_FAILED, "mmap of " + std::to_string(bytes) +
+                                         " bytes failed: " +
+                                         std::strerror(errno));
+#ifdef MADV_HUGEPAGE
+        if (config.hugePages != HugePageMode::None)
+            madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+    }
+    if (config.numaFirstTouch) {
+        // the pages are still unbacked, so this write decides their node
+        const size_t pageSize = hugeTlb ? hugePageSize : sysconf(_SC_PAGESIZE);
+        auto base = static_cast<char *>(ptr);
+        const long nPages = bytes / pageSize;
+#pragma omp parallel for schedule(static)
+        for (long i = 0; i < nPages; ++i)
+            base[i * pageSize] = 0;
+    }
+    return ptr;
+}
+
+void *CpuAllocator::alloc(size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size = std::max<size_t>(size, 1);
+    Allocation allocation;
+    void *ptr;
+    if (size >= config.mapThreshold) {
+        allocation.bytes = roundUp(size, config.hugePages ==
+                                                 HugePageMode::Explicit
+                                             ? hugePageSize
+                                             : sysconf(_SC_PAGESIZE));
+        allocation.mapped = true;
+        ptr = map(allocation.bytes, allocation.hugeTlb);
+        stats.mappedBytes += allocation.bytes;
+        if (allocation.hugeTlb)
+            stats.hugeTlbBytes += allocation.bytes;
+    } else {
+        allocation.bytes = roundUp(size, config.alignment);
+        allocation.mapped = allocation.hugeTlb = false;
+        ptr = aligned_alloc(config.alignment, allocation.bytes);
+        IT_ASSERT(ptr != nullptr,
+                  "aligned_alloc of " + std::to_string(size) + " bytes failed");
+        if (config.zeroFill)
+            memset(ptr, 0, allocation.bytes);
+    }
+    allocations.emplace(ptr, allocation);
+    stats.allocs++;
+    stats.bytesInUse += allocation.bytes;
+    stats.peakBytes = std::max(stats.peakBytes, stats.bytesInUse);
+    return ptr;
+}
+
+void CpuAllocator::dealloc(void *ptr) {
+    if (ptr == nullptr)
+        return;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = allocations.find(ptr);
+    IT_ASSERT(it != allocations.end(), "Freeing an unknown CPU buffer");
+    auto allocation = it->second;
+    allocations.erase(it);
+    if (allocation.mapped) {
+        munmap(ptr, allocation.bytes);
+        stats.mappedBytes -= allocation.bytes;
+        if (allocation.hugeTlb)
+            stats.hugeTlbBytes -= allocation.bytes;
+    } else {
+        free(ptr);
+    }
+    stats.frees++;
+    stats.bytesInUse -= allocation.bytes;
+}
+
+void CpuAllocator::setConfig(const CpuAllocConfig &config) {
+    IT_ASSERT(config.alignment > 0 &&
+              (config.alignment & (config.alignment - 1)) == 0);
+    std::lock_guard<std::mutex> lock(mutex);
+    this->config = config;
+}
+
+CpuAllocConfig CpuAllocator::getConfig() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return config;
+}
+
+CpuAllocStats CpuAllocator::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+string CpuAllocator::toString() const {
+    auto s = getStats();
+    return "CPU allocator: " + std::to_string(s.allocs) + " allocs, " +
+           std::to_string(s.frees) + " frees, " +
+           std::to_string(s.bytesInUse) + " bytes in use, peak " +
+           std::to_string(s.peakBytes) + ", mapped " +
+           std::to_string(s.mappedBytes) + ", hugetlb " +
+           std::to_string(s.hugeTlbBytes) + " (" +
+           std::to_string(s.hugeTlbFallbacks) + " fallbacks)";
+}
+
+} // namespace infini
@@ -1,4 +1,5 @@
 #include "core/graph.h"
+#include "core/kernel.h"
 #include "operators/reshape.h"
 #include <algorithm>
 #include <numeric>
@@ -6,7 +7,7 @@
 
 namespace infini {
 
-GraphObj::GraphObj(Runtime runtime, OpVec ops_in)
+GraphObj::GraphObj(Runtime runtime, OpVec ops_in, bool cloneData)
     : runtime(runtime), allocator(runtime), sorted(false) {
     map<UidBaseType, Tensor> tensorPool;
     // Clone tensors
@@ -14,13 +15,13 @@ GraphObj::GraphObj(Runtime runtime, OpVec ops_in)
         for (const auto &t : op->getInputs()) {
             if (t) {
                 if (tensorPool.find(t->getFuid()) == tensorPool.end())
-                    tensorPool[t->getFuid()] = cloneTensor(t);
+                    tensorPool[t->getFuid()] = cloneTensor(t, cloneData);
             }
         }
         for (const auto &t : op->getOutputs()) {
             if (t) {
                 if (tensorPool.find(t->getFuid()) == tensorPool.end())
-                    tensorPool[t->getFuid()] = cloneTensor(t);
+                    tensorPool[t->getFuid()] = cloneTensor(t, cloneData);
             }
         }
     }
@@ -44,6 +45,7 @@ GraphObj::GraphObj(Runtime runtime, OpVec ops_in)
 
 void GraphObj::addOperatorAndConnect(const Operator &op) {
     sorted = false;
+    allocator.clearPlanCache();
     ops.push_back(op);
     for (auto &input : op->getInputs()) {
         if (input) {
@@ -162,6 +164,7 @@ void GraphObj::dataMalloc(bool useNaiveAllocator, size_t memPoolSize) {
     if (useNaiveAllocator) {
         // can not set memory pool when use naive allocator
         IT_ASSERT(memPoolSize == 0);
+        IT_ASSERT(!allocator.hasWeightFile());
         // used for debugging memory out-of-bounds access, tensors will not be
         // released correctly
         // note: behavior may not match running in non-naive mode, and it may
@@ -177,8 +180,6 @@ void GraphObj::dataMalloc(bool useNaiveAllocator, size_t memPoolSize) {
     if (memPoolSize > 0) {
         allocator.setMemPool(memPoolSize);
     }
-    // count the number of times all tensors are used
-    std::unordered_map<TensorObj *, size_t> tensorToRefCount;
     // record the memory address offsets of all tensors to be allocated
     std::unordered_map<TensorObj *, size_t> tensorToOffset;
 
@@ -197,17 +198,6 @@ void GraphObj::dataMalloc(bool useNaiveAllocator, size_t memPoolSize) {
                 tensorToOffset[tensor.get()] =
                     allocator.allocWeight(tensor->getBytes());
             }
-        } else if (tensor->isInput() || tensor->isOutput()) {
-            // allocate memory for all input and output tensors, and this memory
-            // will not be reused later
-            tensorToOffset[tensor.get()] = allocator.alloc(tensor->getBytes());
-        } else {
-            tensorToRefCount[tensor.get()] = tensor->getTargets().size();
-            // allocate memory for all user-created tensors
-            if (tensor.get()->getSource() == nullptr) {
-                tensorToOffset[tensor.get()] =
-                    allocator.alloc(tensor->getBytes());
-            }
         }
     }
     // if memory has not yet been allocated for weight tensors,
@@ -223,36 +213,16 @@ void GraphObj::dataMalloc(bool useNaiveAllocator, size_t memPoolSize) {
                     tensorToOffset[tensor]));
         }
     }
-    // traverse in topological order and simulate memory allocation
-    for (auto &op : ops) {
-        // memory should be allocated for the op's output first
-        auto outputs = op->getOutputs();
-        for (auto &tensor : outputs) {
-            if (tensor) {
-                if (tensor->isOthers()) {
-                    tensorToOffset[tensor.get()] =
-                        allocator.alloc(tensor->getBytes());
-                }
-            }
-        }
-        auto inputs = op->getInputs();
-        for (auto &tensor : inputs) {
-            if (tensor) {
-                if (tensor->isOthers()) {
-                    auto tensorIter = tensorToRefCount.find(tensor.get());
-                    IT_ASSERT(tensorIter != tensorToRefCount.end());
-                    IT_ASSERT(tensorToRefCount[tensor.get()] > 0);
-                    tensorToRefCount[tensor.get()] -= 1;
-                    if (tensorToRefCount[tensor.get()] == 0) {
-                        // indicate that this tensor will no longer be used and
-                        // perform memory free
-                        tensorToRefCount.erase(tensor.get());
-                        allocator.free(tensorToOffset[tensor.get()],
-                                       tensor->getBytes());
-                    }
-                }
-            }
-        }
+
+    vector<TensorObj *> plannedTensors;
+    for (auto &tensor : tensors)
+        if (!tensor->isWeight())
+            plannedTensors.emplace_back(tensor.get());
+    // a shape of the inputs seen before reuses its plan
+    auto planKey = getMemPlanKey();
+    if (!allocator.loadPlan(planKey, plannedTensors, tensorToOffset)) {
+        planMemory(plannedTensors, tensorToOffset);
+        allocator.savePlan(planKey, plannedTensors, tensorToOffset);
     }
 
     // perform actual memory allocation for non-weight tensors
@@ -267,6 +237,227 @@ void GraphObj::dataMalloc(bool useNaiveAllocator, size_t memPoolSize) {
     }
 }
 
+vector<size_t> GraphObj::getOpLevels() const {
+    IT_ASSERT(sorted);
+    std::unordered_map<OperatorObj *, size_t> opToLevel;
+    vector<size_t> levels;
+    for (auto &op : ops) {
+        size_t level = 0;
+        for (auto &pred : op->getPredecessors())
+            level = std::max(level, opToLevel.at(pred.get()) + 1);
+        opToLevel[op.get()] = level;
+        levels.emplace_back(level);
+    }
+    return levels;
+}
+
+void GraphObj::planMemory(
+    const vector<TensorObj *> &plannedTensors,
+    std::unordered_map<TensorObj *, size_t> &tensorToOffset) {
+    // A step is an op of the topological order, or a level of ops that run
+    // concurrently
+    vector<size_t> steps(ops.size());
+    std::iota(steps.begin(), steps.end(), 0);
+    if (interOpParallel)
+        steps = getOpLevels();
+    vector<size_t> stepWidth(ops.size(), 0);
+    std::unordered_map<OperatorObj *, size_t> opToStep;
+    for (size_t i = 0; i < ops.size(); ++i) {
+        opToStep[ops[i].get()] = steps[i];
+        stepWidth[steps[i]]++;
+    }
+    // lifetime of each tensor, in steps
+    std::unordered_map<TensorObj *, MemBlockLifetime> tensorLifetime;
+    for (auto tensor : plannedTensors) {
+        MemBlockLifetime lifetime{tensor->getBytes(), 0, ops.size()};
+        if (tensor->isOthers()) {
+            if (auto source = tensor->getSource())
+                lifetime.begin = opToStep.at(source.get());
+            if (!tensor->getTargets().empty()) {
+                lifetime.end = lifetime.begin;
+                for (auto &target : tensor->getTargets())
+                    lifetime.end =
+                        std::max(lifetime.end, opToStep.at(target.get()));
+            }
+        }
+        tensorLifetime[tensor] = lifetime;
+    }
+
+    // Tensors sharing a buffer point to the first of them, their root.
+    // - The output of a metadata-only op shares the buffer of its input, so
+    //   the op does nothing at run time.
+    // - The output of an op whose kernel supports in-place execution takes
+    //   over the buffer of an input of the same shape that dies at the op.
+    // Ops are sorted, so all earlier users of a buffer are known when an op
+    // is visited. An op sharing its step with others can not run in place,
+    // since they may read the buffer concurrently.
+    std::unordered_map<TensorObj *, TensorObj *> aliasRoot;
+    // last step and pinning of the buffer of each root
+    std::unordered_map<TensorObj *, size_t> rootEnd;
+    std::unordered_map<TensorObj *, bool> rootPinned;
+    for (auto tensor : plannedTensors) {
+        aliasRoot[tensor] = tensor;
+        rootEnd[tensor] = tensorLifetime[tensor].end;
+        rootPinned[tensor] = tensor->isInput() || tensor->isOutput();
+    }
+    auto share = [&](TensorObj *input, TensorObj *output) {
+        auto root = aliasRoot.at(input);
+        aliasRoot[output] = root;
+        rootEnd[root] = std::max(rootEnd[root], tensorLifetime[output].end);
+        rootPinned[root] = rootPinned[root] || rootPinned[output];
+    };
+    auto &kernelRegistry = KernelRegistry::getInstance();
+    for (size_t i = 0; i < ops.size(); ++i) {
+        auto &op = ops[i];
+        auto step = steps[i];
+        if (op->getOutputs().size() != 1 || !op->getOutput() ||
+            op->getOutput()->isWeight())
+            continue;
+        auto output = op->getOutput();
+        if (op->getOpType().isView()) {
+            auto input = op->getInputs(0);
+            if (input && !input->isWeight() &&
+                input->getBytes() == output->getBytes())
+                share(input.get(), output.get());
+            continue;
+        }
+        auto kernelAttrs =
+            KernelAttrs{runtime->getDevice(), op->getOpType().underlying()};
+        if (!inPlacePlanning || stepWidth[step] > 1 || !output->isOthers() ||
+            !kernelRegistry.hasKernel(kernelAttrs) ||
+            !kernelRegistry.getKernel(kernelAttrs)->supportsInPlace())
+            continue;
+        for (auto &input : op->getInputs()) {
+            if (!input || !input->isOthers() ||
+                input->getDims() != output->getDims() ||
+                !(input->getDType() == output->getDType()))
+                continue;
+            // the buffer must die at this op and not be read through another
+            // input, which may be indexed differently
+            auto root = aliasRoot.at(input.get());
+            bool reusable = !rootPinned[root] && rootEnd[root] == step;
+            for (auto &other : op->getInputs())
+                if (other && other != input && !other->isWeight() &&
+                    aliasRoot.at(other.get()) == root)
+                    reusable = false;
+            if (reusable) {
+                share(input.get(), output.get());
+                break;
+            }
+        }
+    }
+
+    // one block per buffer, live from the first step any tensor sharing it is
+    // live to the last one
+    std::unordered_map<TensorObj *, size_t> rootToBlock;
+    vector<MemBlockLifetime> lifetimes;
+    // a block is pinned if it holds a graph input or output
+    vector<bool> pinned;
+    // the number of times the tensors of each block are used
+    vector<size_t> refCount;
+    auto blockOf = [&](TensorObj *tensor) {
+        return rootToBlock.at(aliasRoot.at(tensor));
+    };
+    for (auto tensor : plannedTensors) {
+        const auto &lifetime = tensorLifetime[tensor];
+        auto [it, inserted] =
+            rootToBlock.try_emplace(aliasRoot.at(tensor), lifetimes.size());
+        if (inserted) {
+            lifetimes.emplace_back(lifetime);
+            pinned.emplace_back(false);
+            refCount.emplace_back(0);
+        }
+        auto &block = lifetimes[it->second];
+        block.begin = std::min(block.begin, lifetime.begin);
+        block.end = std::max(block.end, lifetime.end);
+        pinned[it->second] =
+            pinned[it->second] || tensor->isInput() || tensor->isOutput();
+        refCount[it->second] += tensor->getTargets().size();
+    }
+
+    vector<size_t> offsets(lifetimes.size(), 0);
+    if (memPlanStrategy != MemPlanStrategy::Online) {
+        // place every block at once
+        offsets = allocator.planOffline(lifetimes, memPlanStrategy);
+    } else {
+        allocator.boundPeak(lifetimes);
+        vector<bool> allocated(lifetimes.size(), false);
+        for (auto tensor : plannedTensors) {
+            // allocate memory for all input and output tensors, and this
+            // memory will not be reused later, and for all user-created
+            // tensors
+            size_t block = blockOf(tensor);
+            if (!allocated[block] &&
+                (pinned[block] || tensor->getSource() == nullptr)) {
+                offsets[block] = allocator.alloc(lifetimes[block].size);
+                allocated[block] = true;
+            }
+        }
+        // traverse step by step and simulate memory allocation
+        vector<vector<Operator>> stepOps(ops.size());
+        for (size_t i = 0; i < ops.size(); ++i)
+            stepOps[steps[i]].emplace_back(ops[i]);
+        for (auto &opsOfStep : stepOps) {
+            // memory should be allocated for the outputs of the step first,
+            // unless they share the buffer of an input
+            for (auto &op : opsOfStep) {
+                for (auto &tensor : op->getOutputs()) {
+                    if (tensor && tensor->isOthers()) {
+                        size_t block = blockOf(tensor.get());
+                        if (!allocated[block]) {
+                            offsets[block] =
+                                allocator.alloc(lifetimes[block].size);
+                            allocated[block] = true;
+                        }
+                    }
+                }
+            }
+            for (auto &op : opsOfStep) {
+                for (auto &tensor : op->getInputs()) {
+                    if (tensor && tensor->isOthers()) {
+                        size_t block = blockOf(tensor.get());
+                        IT_ASSERT(refCount[block] > 0);
+                        refCount[block] -= 1;
+                        if (refCount[block] == 0 && !pinned[block]) {
+                            // indicate that no tensor of this block will be
+                            // used any more and perform memory free
+                            allocator.free(offsets[block],
+                                           lifetimes[block].size);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    for (auto tensor : plannedTensors)
+        tensorToOffset[tensor] = offsets[blockOf(tensor)];
+}
+
+vector<int> GraphObj::getMemPlanKey() const {
+    // the options, then the id and shape of every non-weight graph input
+    vector<int> key{enum_to_underlying(memPlanStrategy), inPlacePlanning,
+                    interOpParallel};
+    for (auto &tensor : tensors) {
+        if (tensor->isWeight() || tensor->getSource())
+            continue;
+        key.emplace_back(tensor->getFuid());
+        key.emplace_back(tensor->getRank());
+        for (int d : tensor->getDims())
+            key.emplace_back(d);
+    }
+    return key;
+}
+
+void GraphObj::setWeightFile(const string &path) {
+    IT_ASSERT(!weightAllocated, "Weights are already allocated");
+    allocator.setWeightFile(path);
+}
+
+void GraphObj::saveWeights(const string &path) {
+    IT_ASSERT(weightAllocated, "Call dataMalloc before saving the weights");
+    allocator.saveWeights(path);
+}
+
 Tensor GraphObj::cloneKV(Tensor &tensor) {
     auto obj = tensor->clone();
     if (allocator.getMemPoolStatus()) {
@@ -321,6 +512,7 @@ void GraphObj::deleteConnection(Tensor tensor, Operator op) {
                         tensor->getTargets().end(),
                         op) != tensor->getTargets().end());
     tensor->removeTarget(op);
+    allocator.clearPlanCache();
     if (tensor->getSource()) {
         tensor->getSource()->removeSuccessors(op);
         op->removePredecessors(tensor->getSource());
@@ -330,6 +522,7 @@ void GraphObj::deleteConnection(Tensor tensor, Operator op) {
 // add op as a target
 void GraphObj::addConnection(Tensor tensor, Operator op) {
     tensor->addTarget(op);
+    allocator.clearPlanCache();
     if (tensor->getSource()) {
         tensor->getSource()->addSuccessors(op);
         op->addPredecessors(tensor->getSource());
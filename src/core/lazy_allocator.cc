@@ -1,4 +1,13 @@
 #include "core/lazy_allocator.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <numeric>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <utility>
 
 namespace infini {
@@ -10,10 +19,30 @@ namespace infini {
 // to at least 256 bytes.
 constexpr size_t alignmentInBytesForCUDA = 256;
 
+// Layout of a weight file: this header, the size of each weight block before
+// alignment as uint64_t, zero padding up to dataOffset, then the weight arena
+// image
+struct WeightFileHeader {
+    char magic[8];
+    uint64_t version;
+    uint64_t alignment;
+    uint64_t numBlocks;
+    uint64_t arenaBytes;
+    // page aligned, so that the mapped arena is page aligned
+    uint64_t dataOffset;
+};
+constexpr char weightFileMagic[8] = {'I', 'T', 'W', 'E', 'I', 'G', 'H', 'T'};
+constexpr uint64_t weightFileVersion = 1;
+constexpr size_t weightFilePage = 4096;
+
 LazyAllocator::LazyAllocator(Runtime runtime) : runtime(runtime) {
     if (runtime->isCuda()) {
         // TODO: the alignment on cuda might need further discussion
         alignment = alignmentInBytesForCUDA;
+    } else if (auto cpu = as<NativeCpuRuntimeObj>(runtime)) {
+        // align tensors inside the arenas as the CPU allocator aligns the
+        // arenas, so that SIMD kernels can use aligned loads
+        alignment = cpu->getAllocator().getConfig().alignment;
     } else {
         // 'alignment' defaults to sizeof(uint64_t), because it is the length of
         // the longest data type currently supported by the DataType field of
@@ -27,7 +56,9 @@ LazyAllocator::~LazyAllocator() {
     if (this->ptr != nullptr) {
         runtime->dealloc(this->ptr);
     }
-    if (this->weightPtr != nullptr) {
+    if (this->weightMap != nullptr) {
+        munmap(this->weightMap, this->weightMapSize);
+    } else if (this->weightPtr != nullptr) {
         runtime->dealloc(this->weightPtr);
     }
     if (this->memPoolPtr != nullptr) {
@@ -38,13 +69,12 @@ LazyAllocator::~LazyAllocator() {
 void LazyAllocator::init() {
     used = 0;
     peak = 0;
+    lowerBound = 0;
     freeBlocks.clear();
     headAddrToBlockSize.clear();
     tailAddrToBlockSize.clear();
-    if (this->ptr != nullptr) {
-        runtime->dealloc(this->ptr);
-    }
-    this->ptr = nullptr;
+    // keep ptr, it is reused if it is large enough for the next plan
+    this->ptrBound = false;
 }
 
 void LazyAllocator::setMemPool(size_t memPoolSize) {
@@ -110,6 +140,7 @@ size_t LazyAllocator::alloc(size_t size) {
 
 size_t LazyAllocator::allocWeight(size_t size) {
     IT_ASSERT(this->weightPtr == nullptr);
+    this->weightSizes.emplace_back(size);
     size = this->getAlignedSize(size);
     size_t retAddr = this->weightPeak;
     this->weightPeak += size;
@@ -127,8 +158,135 @@ size_t LazyAllocator::heapAlloc(size_t size) {
 
 void LazyAllocator::freeHeap() { this->heapPeak = 0; }
 
+vector<size_t>
+LazyAllocator::planOffline(const vector<MemBlockLifetime> &blocks,
+                           MemPlanStrategy strategy) {
+    IT_ASSERT(!this->ptrBound);
+    IT_ASSERT(this->used == 0 && this->peak == 0);
+    const size_t n = blocks.size();
+    vector<size_t> sizes(n);
+    for (size_t i = 0; i < n; ++i)
+        sizes[i] = getAlignedSize(blocks[i].size);
+    // larger blocks first, earlier ones first among equal sizes
+    auto bySize = [&](size_t a, size_t b) {
+        return sizes[a] != sizes[b] ? sizes[a] > sizes[b]
+                                    : blocks[a].begin < blocks[b].begin;
+    };
+    vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), bySize);
+    if (strategy == MemPlanStrategy::GreedyByBreadth) {
+        // visit steps from the widest one, and each step's blocks by size
+        size_t steps = 0;
+        for (auto &block : blocks)
+            steps = std::max(steps, block.end + 1);
+        vector<size_t> breadth(steps, 0);
+        vector<vector<size_t>> live(steps);
+        for (size_t i : order)
+            for (size_t t = blocks[i].begin; t <= blocks[i].end; ++t) {
+                breadth[t] += sizes[i];
+                live[t].emplace_back(i);
+            }
+        vector<size_t> stepOrder(steps);
+        std::iota(stepOrder.begin(), stepOrder.end(), 0);
+        std::stable_sort(
+            stepOrder.begin(), stepOrder.end(),
+            [&](size_t a, size_t b) { return breadth[a] > breadth[b]; });
+        vector<bool> queued(n, false);
+        order.clear();
+        for (size_t t : stepOrder)
+            for (size_t i : live[t])
+                if (!queued[i]) {
+                    queued[i] = true;
+                    order.emplace_back(i);
+                }
+    } else {
+        IT_ASSERT(strategy == MemPlanStrategy::GreedyBySize);
+    }
+
+    // place each block at the smallest gap between the blocks already placed
+    // that overlap it in time, or above all of them
+    vector<size_t> offsets(n, 0);
+    vector<size_t> placed; // sorted by offset
+    for (size_t i : order) {
+        size_t prevTail = 0, bestAddr = SIZE_MAX, bestGap = SIZE_MAX;
+        for (size_t j : placed) {
+            if (blocks[j].end < blocks[i].begin ||
+                blocks[i].end < blocks[j].begin)
+                continue;
+            if (offsets[j] >= prevTail) {
+                size_t gap = offsets[j] - prevTail;
+                if (gap >= sizes[i] && gap < bestGap) {
+                    bestGap = gap;
+                    bestAddr = prevTail;
+                }
+            }
+            prevTail = std::max(prevTail, offsets[j] + sizes[j]);
+        }
+        offsets[i] = bestAddr != SIZE_MAX ? bestAddr : prevTail;
+        this->peak = std::max(this->peak, offsets[i] + sizes[i]);
+        auto pos = std::upper_bound(
+            placed.begin(), placed.end(), offsets[i],
+            [&](size_t addr, size_t j) { return addr < offsets[j]; });
+        placed.insert(pos, i);
+    }
+    boundPeak(blocks);
+    return offsets;
+}
+
+size_t LazyAllocator::boundPeak(const vector<MemBlockLifetime> &blocks) {
+    size_t steps = 0;
+    for (auto &block : blocks)
+        steps = std::max(steps, block.end + 1);
+    // difference array of live bytes over the steps
+    vector<int64_t> delta(steps + 1, 0);
+    for (auto &block : blocks) {
+        delta[block.begin] += getAlignedSize(block.size);
+        delta[block.end + 1] -= getAlignedSize(block.size);
+    }
+    size_t liveBytes = 0;
+    this->lowerBound = 0;
+    for (size_t t = 0; t < steps; ++t) {
+        liveBytes += delta[t];
+        this->lowerBound = std::max(this->lowerBound, liveBytes);
+    }
+    return this->lowerBound;
+}
+
+bool LazyAllocator::loadPlan(
+    const vector<int> &key, const vector<TensorObj *> &tensors,
+    std::unordered_map<TensorObj *, size_t> &tensorToOffset) {
+    auto it = this->planCache.find(key);
+    if (it == this->planCache.end())
+        return false;
+    const MemPlan &plan = it->second;
+    if (plan.tensors != tensors)
+        return false;
+    for (size_t i = 0; i < tensors.size(); ++i)
+        if (plan.bytes[i] != tensors[i]->getBytes())
+            return false;
+    IT_ASSERT(!this->ptrBound);
+    for (size_t i = 0; i < tensors.size(); ++i)
+        tensorToOffset[tensors[i]] = plan.offsets[i];
+    this->used = plan.used;
+    this->peak = plan.peak;
+    this->lowerBound = plan.lowerBound;
+    return true;
+}
+
+void LazyAllocator::savePlan(
+    const vector<int> &key, const vector<TensorObj *> &tensors,
+    const std::unordered_map<TensorObj *, size_t> &tensorToOffset) {
+    MemPlan plan{tensors, {}, {}, this->used, this->peak, this->lowerBound};
+    for (auto tensor : tensors) {
+        plan.bytes.emplace_back(tensor->getBytes());
+        plan.offsets.emplace_back(tensorToOffset.at(tensor));
+    }
+    this->planCache[key] = std::move(plan);
+}
+
 void LazyAllocator::free(size_t addr, size_t size) {
-    IT_ASSERT(this->ptr == nullptr);
+    IT_ASSERT(!this->ptrBound);
     size = getAlignedSize(size);
     auto tailAddr = addr + size;
     freeBlockInfo block = {addr, tailAddr - addr};
@@ -169,13 +327,20 @@ void LazyAllocator::free(size_t addr, size_t size) {
 
 void *LazyAllocator::getPtr() {
     if (!hasMemPool) {
-        if (this->ptr == nullptr) {
+        if (this->ptr == nullptr || this->ptrSize < this->peak) {
+            // grow only, so that the buffer ends up sized for the largest
+            // plan and is not reallocated when switching between shapes
+            if (this->ptr != nullptr) {
+                runtime->dealloc(this->ptr);
+            }
             this->ptr = runtime->alloc(this->peak);
+            this->ptrSize = this->peak;
             // #ifdef DEBUG_MODE
             //         printf("LazyAllocator really alloc non-weight: %p %lu
             //         bytes\n", this->ptr, peak);
             // #endif
         }
+        this->ptrBound = true;
         return this->ptr;
     } else {
         IT_ASSERT(this->memPoolSize >= this->weightPeak + this->peak);
@@ -185,7 +350,9 @@ void *LazyAllocator::getPtr() {
 
 void *LazyAllocator::getWeightPtr() {
     if (!hasMemPool) {
-        if (this->weightPtr == nullptr) {
+        if (this->weightPtr == nullptr && hasWeightFile()) {
+            this->weightPtr = mapWeightFile();
+        } else if (this->weightPtr == nullptr) {
             this->weightPtr = runtime->alloc(this->weightPeak);
             // #ifdef DEBUG_MODE
             //         printf("LazyAllocator really alloc weight: %p %lu
@@ -195,10 +362,92 @@ void *LazyAllocator::getWeightPtr() {
         }
         return this->weightPtr;
     } else {
+        IT_ASSERT(!hasWeightFile(), "Weight files bypass the memory pool");
         return this->memPoolPtr;
     }
 }
 
+void LazyAllocator::setWeightFile(const string &path) {
+    IT_ASSERT(this->weightPtr == nullptr,
+              "The weight arena is already allocated");
+    this->weightFile = path;
+}
+
+void *LazyAllocator::mapWeightFile() {
+    int fd = open(weightFile.c_str(), O_RDONLY);
+    IT_ASSERT(fd >= 0, "Cannot open weight file " + weightFile + ": " +
+                           std::strerror(errno));
+    struct stat st;
+    IT_ASSERT(fstat(fd, &st) == 0);
+    size_t fileSize = st.st_size;
+    IT_ASSERT(fileSize >= sizeof(WeightFileHeader),
+              weightFile + " is not a weight file");
+    // private and writable: pages come from the page cache and are copied
+    // only when written
+    void *base = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                      fd, 0);
+    close(fd);
+    IT_ASSERT(base != MAP_FAILED, "Cannot map weight file " + weightFile +
+                                      ": " + std::strerror(errno));
+
+    auto header = static_cast<const WeightFileHeader *>(base);
+    auto sizes = reinterpret_cast<const uint64_t *>(header + 1);
+    IT_ASSERT(memcmp(header->magic, weightFileMagic, 8) == 0 &&
+                  header->version == weightFileVersion,
+              weightFile + " is not a weight file");
+    IT_ASSERT(header->alignment == alignment &&
+                  header->numBlocks == weightSizes.size() &&
+                  header->arenaBytes == weightPeak &&
+                  fileSize >= header->dataOffset + header->arenaBytes &&
+                  std::equal(weightSizes.begin(), weightSizes.end(), sizes),
+              weightFile + " was saved from a different graph");
+    auto arena = static_cast<uint8_t *>(base) + header->dataOffset;
+    if (runtime->isCpu()) {
+        this->weightMap = base;
+        this->weightMapSize = fileSize;
+        return arena;
+    }
+    // other devices read the weights from the mapping once
+    void *ptr = runtime->alloc(this->weightPeak);
+    runtime->copyBlobFromCPU(ptr, arena, this->weightPeak);
+    munmap(base, fileSize);
+    return ptr;
+}
+
+void LazyAllocator::saveWeights(const string &path) {
+    IT_ASSERT(this->weightPtr != nullptr, "The weights are not allocated");
+    IT_ASSERT(!hasMemPool, "Weight files bypass the memory pool");
+    WeightFileHeader header;
+    memcpy(header.magic, weightFileMagic, 8);
+    header.version = weightFileVersion;
+    header.alignment = alignment;
+    header.numBlocks = weightSizes.size();
+    header.arenaBytes = weightPeak;
+    header.dataOffset =
+        (sizeof(header) + weightSizes.size() * sizeof(uint64_t) +
+         weightFilePage - 1) /
+        weightFilePage * weightFilePage;
+    vector<uint64_t> sizes(weightSizes.begin(), weightSizes.end());
+    vector<char> padding(header.dataOffset - sizeof(header) -
+                             sizes.size() * sizeof(uint64_t),
+                         0);
+
+    std::ofstream file(path, std::ios::binary);
+    IT_ASSERT(file.good(), "Cannot write weight file " + path);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(sizes.data()),
+               sizes.size() * sizeof(uint64_t));
+    file.write(padding.data(), padding.size());
+    if (runtime->isCpu()) {
+        file.write(static_cast<const char *>(weightPtr), weightPeak);
+    } else {
+        vector<char> host(weightPeak);
+        runtime->copyBlobToCPU(host.data(), weightPtr, weightPeak);
+        file.write(host.data(), host.size());
+    }
+    IT_ASSERT(file.good(), "Cannot write weight file " + path);
+}
+
 void *LazyAllocator::getHeapPtr() {
     IT_ASSERT(hasMemPool);
     return this->memPoolPtr;
@@ -210,8 +459,15 @@ size_t LazyAllocator::getAlignedSize(size_t size) {
 
 void LazyAllocator::info() {
     std::cout << "Used memory: " << this->used + this->weightPeak
-              << ", peak memory: " << this->peak + this->weightPeak
-              << std::endl;
+              << ", peak memory: " << this->peak + this->weightPeak;
+    if (this->lowerBound > 0) {
+        std::cout << ", activation peak: " << this->peak
+                  << ", lower bound: " << this->lowerBound << " ("
+                  << 100.0 * this->peak / this->lowerBound - 100 << "% above)";
+    }
+    std::cout << std::endl;
+    if (auto cpu = as<NativeCpuRuntimeObj>(runtime))
+        std::cout << cpu->getAllocator().toString() << std::endl;
 }
 
 } // namespace infini
@@ -286,4 +286,14 @@ bool OpType::isMatMulOrConv() const {
     return set.find(type) != set.end();
 }
 
+// Ops that only change the metadata of their input, whose output can share
+// the input's data.
+bool OpType::isView() const {
+    static const std::unordered_set<decltype(type)> set{
+        Reshape, Flatten, Squeeze, Unsqueeze, Identity,
+    };
+
+    return set.find(type) != set.end();
+}
+
 } // namespace infini
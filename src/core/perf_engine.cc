@@ -1,9 +1,76 @@
 #include "core/perf_engine.h"
+#include <cstring>
 #include <fstream>
+#include <nlohmann/json.hpp>
 namespace infini {
 
 REGISTER_CONSTRUCTOR(0, PerfRecordObj::from_json);
 
+/* json register should in the common namespace with corresponding type*/
+void to_json(json &j, const OpPerfKey &p) {
+    j = json{{"hashType", p.hash}, {"opType", p.opType}, {"attrs", p.attrs}};
+}
+void from_json(const json &j, OpPerfKey &p) {
+    j.at("hashType").get_to(p.hash);
+    j.at("opType").get_to(p.opType);
+    j.at("attrs").get_to(p.attrs);
+}
+void to_json(json &j, const DataType &p) { j = p.getIndex(); }
+void from_json(const json &j, DataType &p) { p = DataType(j.get<int>()); }
+void to_json(json &j, const PerfRecord &p) { p->to_json(j); }
+void from_json(const json &j, PerfRecord &p) {
+    int type = j["type"].get<int>();
+    p = PerfRecordRegistry::getInstance().getConstructor(type)(j);
+}
+
+size_t PerfEngine::size() const {
+    size_t ret = 0;
+    for (auto &shard : shards) {
+        std::shared_lock lock(shard.mutex);
+        ret += shard.data.size();
+    }
+    return ret;
+}
+
+map<PerfEngine::Key, PerfRecord> PerfEngine::get_data() const {
+    map<Key, PerfRecord> ret;
+    for (auto &shard : shards) {
+        std::shared_lock lock(shard.mutex);
+        ret.insert(shard.data.begin(), shard.data.end());
+    }
+    return ret;
+}
+
+void PerfEngine::set_data(const map<Key, PerfRecord> &data) {
+    for (auto &shard : shards) {
+        std::unique_lock lock(shard.mutex);
+        shard.data.clear();
+    }
+    ++version;
+    merge_data(data);
+}
+
+size_t PerfEngine::merge_data(const map<Key, PerfRecord> &data,
+                              MergePolicy policy) {
+    size_t ret = 0;
+    for (auto &[key, record] : data) {
+        auto &shard = getShard(key);
+        std::unique_lock lock(shard.mutex);
+        auto [it, inserted] = shard.data.emplace(key, record);
+        if (inserted)
+            ++ret;
+        else if (policy == MergePolicy::Overwrite ||
+                 (policy == MergePolicy::KeepFaster &&
+                  record->time < it->second->time)) {
+            it->second = record;
+            ++ret;
+        }
+    }
+    if (ret > 0)
+        ++version;
+    return ret;
+}
+
 void PerfEngine::savePerfEngineData(std::string file_path) {
     std::ofstream fileout(file_path,
                           std::ios::out | std::ios::trunc | std::ios::binary);
@@ -14,28 +81,146 @@ void PerfEngine::savePerfEngineData(std::string file_path) {
 
 void PerfEngine::loadPerfEngineData(std::string file_path) {
     std::ifstream filein(file_path, std::ios::in | std::ios::binary);
-    string t;
-    filein >> t;
-    json j = json::parse(t);
+    IT_ASSERT(filein, "Failed to open " + file_path);
+    json j = json::parse(filein);
     from_json(j, this->getInstance());
     filein.close();
 }
 
-/* json register should in the common namespace with corresponding type*/
-void to_json(json &j, const OpPerfKey &p) {
-    j = json{{"hashType", p.hash}, {"opType", p.opType}, {"attrs", p.attrs}};
+/*
+ * Binary layout, in host byte order:
+ *   header: magic "ITPERFDB" (8 bytes), version (uint32)
+ *   records, each:
+ *     size of the rest of the record (uint32)
+ *     device (int32), opType (int32), hash (uint64)
+ *     number of attrs (uint32), attrs (int32 each)
+ *     the PerfRecord, as the MessagePack encoding of its json
+ * Records are only appended, and a later record of the same key replaces an
+ * earlier one when loading.
+ */
+namespace {
+constexpr char binaryMagic[8] = {'I', 'T', 'P', 'E', 'R', 'F', 'D', 'B'};
+constexpr uint32_t binaryVersion = 1;
+
+template <typename T> void putValue(string &buf, T value) {
+    buf.append(reinterpret_cast<const char *>(&value), sizeof(T));
 }
-void from_json(const json &j, OpPerfKey &p) {
-    j.at("hashType").get_to(p.hash);
-    j.at("opType").get_to(p.opType);
-    j.at("attrs").get_to(p.attrs);
+
+template <typename T> T getValue(const char *&ptr) {
+    T value;
+    std::memcpy(&value, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return value;
 }
-void to_json(json &j, const DataType &p) { j = p.getIndex(); }
-void from_json(const json &j, DataType &p) { p = DataType(j.get<int>()); }
-void to_json(json &j, const PerfRecord &p) { p->to_json(j); }
-void from_json(const json &j, PerfRecord &p) {
-    int type = j["type"].get<int>();
-    p = PerfRecordRegistry::getInstance().getConstructor(type)(j);
+
+void writeHeader(std::ostream &out) {
+    string buf(binaryMagic, sizeof(binaryMagic));
+    putValue(buf, binaryVersion);
+    out.write(buf.data(), buf.size());
+}
+
+void writeRecord(std::ostream &out, const PerfEngine::Key &key,
+                 const PerfRecord &record) {
+    string buf;
+    auto &[device, opType] = key.first;
+    putValue<int32_t>(buf, enum_to_underlying(device));
+    putValue<int32_t>(buf, opType);
+    putValue<uint64_t>(buf, key.second.hash);
+    putValue<uint32_t>(buf, key.second.attrs.size());
+    for (int attr : key.second.attrs)
+        putValue<int32_t>(buf, attr);
+    json j;
+    record->to_json(j);
+    auto payload = json::to_msgpack(j);
+    buf.append(payload.begin(), payload.end());
+    string size;
+    putValue<uint32_t>(size, buf.size());
+    out.write(size.data(), size.size());
+    out.write(buf.data(), buf.size());
+}
+
+map<PerfEngine::Key, PerfRecord> readRecords(const string &file_path) {
+    std::ifstream filein(file_path, std::ios::in | std::ios::binary);
+    IT_ASSERT(filein, "Failed to open " + file_path);
+    string buf((std::istreambuf_iterator<char>(filein)),
+               std::istreambuf_iterator<char>());
+    const char *ptr = buf.data(), *end = buf.data() + buf.size();
+    IT_ASSERT(buf.size() >= sizeof(binaryMagic) + sizeof(uint32_t) &&
+                  std::memcmp(ptr, binaryMagic, sizeof(binaryMagic)) == 0,
+              file_path + " is not a PerfEngine binary file");
+    ptr += sizeof(binaryMagic);
+    auto version = getValue<uint32_t>(ptr);
+    IT_ASSERT(version == binaryVersion,
+              "Unsupported PerfEngine binary version " +
+                  std::to_string(version));
+    map<PerfEngine::Key, PerfRecord> ret;
+    while (end - ptr >= static_cast<ptrdiff_t>(sizeof(uint32_t))) {
+        auto size = getValue<uint32_t>(ptr);
+        if (end - ptr < static_cast<ptrdiff_t>(size))
+            break; // truncated by an interrupted append
+        const char *recordEnd = ptr + size;
+        // device, op type, hash and number of attrs
+        IT_ASSERT(size >= 2 * sizeof(int32_t) + sizeof(uint64_t) +
+                              sizeof(uint32_t),
+                  "Corrupted record in " + file_path);
+        auto device = static_cast<Device>(getValue<int32_t>(ptr));
+        auto opType = getValue<int32_t>(ptr);
+        auto hash = getValue<uint64_t>(ptr);
+        auto count = getValue<uint32_t>(ptr);
+        IT_ASSERT(count <= (recordEnd - ptr) / sizeof(int32_t),
+                  "Corrupted record in " + file_path);
+        vector<int> attrs(count);
+        for (auto &attr : attrs)
+            attr = getValue<int32_t>(ptr);
+        json j = json::from_msgpack(ptr, recordEnd);
+        PerfRecord record;
+        from_json(j, record);
+        OpPerfKey perfKey(hash, OpType(opType), attrs);
+        ret[{KernelAttrs{device, opType}, perfKey}] = record;
+        ptr = recordEnd;
+    }
+    return ret;
+}
+} // namespace
+
+void PerfEngine::savePerfEngineBinary(const std::string &file_path) const {
+    std::ofstream fileout(file_path,
+                          std::ios::out | std::ios::trunc | std::ios::binary);
+    IT_ASSERT(fileout, "Failed to open " + file_path);
+    writeHeader(fileout);
+    for (auto &[key, record] : get_data())
+        writeRecord(fileout, key, record);
+}
+
+size_t PerfEngine::loadPerfEngineBinary(const std::string &file_path,
+                                        MergePolicy policy) {
+    return merge_data(readRecords(file_path), policy);
+}
+
+void PerfEngine::attachPerfEngineBinary(const std::string &file_path) {
+    std::lock_guard lock(logMutex);
+    if (logFile.is_open())
+        logFile.close();
+    if (file_path.empty())
+        return;
+    if (std::ifstream(file_path).good())
+        merge_data(readRecords(file_path), MergePolicy::KeepExisting);
+    // Rewrite the file with all records, which also persists the records
+    // that are only in memory and drops a truncated record at the end
+    logFile.open(file_path, std::ios::trunc | std::ios::binary);
+    IT_ASSERT(logFile, "Failed to open " + file_path);
+    writeHeader(logFile);
+    for (auto &[key, record] : get_data())
+        writeRecord(logFile, key, record);
+    logFile.flush();
+}
+
+void PerfEngine::appendToLog(const Key &key, const PerfRecord &record) {
+    std::lock_guard lock(logMutex);
+    if (!logFile.is_open())
+        return;
+    writeRecord(logFile, key, record);
+    logFile.flush();
 }
 
 void to_json(json &j, const PerfEngine &p) {
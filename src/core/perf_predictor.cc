@@ -0,0 +1,169 @@
+#include "core/perf_predictor.h"
+#include <cmath>
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+namespace infini {
+
+namespace {
+constexpr double ridge = 1e-3;
+
+// The first element of a workload vector is the op type, which is constant
+// within a model.
+vector<double> toFeatures(const OpPerfKey &key) {
+    vector<double> ret;
+    for (size_t i = 1; i < key.attrs.size(); ++i)
+        ret.emplace_back(std::log1p(std::max(key.attrs[i], 0)));
+    return ret;
+}
+
+PerfPredictor::ModelKey toModelKey(const PerfPredictor::Key &key) {
+    return {std::get<0>(key.first), key.second.opType,
+            key.second.attrs.size()};
+}
+
+double evaluate(const vector<double> &weights, const vector<double> &x) {
+    double ret = weights[0];
+    for (size_t i = 0; i < x.size(); ++i)
+        ret += weights[i + 1] * x[i];
+    return ret;
+}
+
+// Solve ridge regression by normal equations, skipping sample `skip`
+vector<double> fit(const vector<vector<double>> &xs, const vector<double> &ys,
+                   size_t skip) {
+    size_t p = xs[0].size() + 1;
+    // Augmented matrix [X^T X + ridge * I | X^T y]
+    vector<vector<double>> a(p, vector<double>(p + 1, 0));
+    for (size_t s = 0; s < xs.size(); ++s) {
+        if (s == skip)
+            continue;
+        for (size_t i = 0; i < p; ++i) {
+            double xi = i == 0 ? 1 : xs[s][i - 1];
+            for (size_t j = 0; j < p; ++j)
+                a[i][j] += xi * (j == 0 ? 1 : xs[s][j - 1]);
+            a[i][p] += xi * ys[s];
+        }
+    }
+    // The bias is not regularized
+    for (size_t i = 1; i < p; ++i)
+        a[i][i] += ridge;
+    // Gaussian elimination with partial pivoting
+    for (size_t c = 0; c < p; ++c) {
+        size_t pivot = c;
+        for (size_t r = c + 1; r < p; ++r)
+            if (std::abs(a[r][c]) > std::abs(a[pivot][c]))
+                pivot = r;
+        std::swap(a[c], a[pivot]);
+        if (std::abs(a[c][c]) < 1e-12)
+            continue;
+        for (size_t r = 0; r < p; ++r) {
+            if (r == c)
+                continue;
+            double f = a[r][c] / a[c][c];
+            for (size_t k = c; k <= p; ++k)
+                a[r][k] -= f * a[c][k];
+        }
+    }
+    vector<double> weights(p, 0);
+    for (size_t i = 0; i < p; ++i)
+        if (std::abs(a[i][i]) >= 1e-12)
+            weights[i] = a[i][p] / a[i][i];
+    return weights;
+}
+} // namespace
+
+void PerfPredictor::train(const Records &records, size_t minSamples) {
+    IT_ASSERT(minSamples >= 2);
+    map<ModelKey, pair<vector<vector<double>>, vector<double>>> samples;
+    for (auto &[key, record] : records) {
+        if (record->time <= 0)
+            continue;
+        auto &[xs, ys] = samples[toModelKey(key)];
+        xs.emplace_back(toFeatures(key.second));
+        ys.emplace_back(std::log(record->time));
+    }
+    models.clear();
+    for (auto &[modelKey, sample] : samples) {
+        auto &[xs, ys] = sample;
+        if (xs.size() < minSamples)
+            continue;
+        Model model;
+        model.numSamples = xs.size();
+        model.weights = fit(xs, ys, xs.size());
+        model.minFeatures = model.maxFeatures = xs[0];
+        for (auto &x : xs)
+            for (size_t i = 0; i < x.size(); ++i) {
+                model.minFeatures[i] = std::min(model.minFeatures[i], x[i]);
+                model.maxFeatures[i] = std::max(model.maxFeatures[i], x[i]);
+            }
+        double sse = 0;
+        for (size_t s = 0; s < xs.size(); ++s) {
+            double err = evaluate(fit(xs, ys, s), xs[s]) - ys[s];
+            sse += err * err;
+        }
+        model.looError = std::sqrt(sse / xs.size());
+        models.emplace(modelKey, std::move(model));
+    }
+}
+
+PerfPredictor::Prediction PerfPredictor::predict(const Key &key) const {
+    auto it = models.find(toModelKey(key));
+    if (it == models.end())
+        return {};
+    auto &model = it->second;
+    auto x = toFeatures(key.second);
+    // Distance out of the trained range, in log space
+    double extrapolation = 0;
+    for (size_t i = 0; i < x.size(); ++i)
+        extrapolation += std::max(0.0, model.minFeatures[i] - x[i]) +
+                         std::max(0.0, x[i] - model.maxFeatures[i]);
+    Prediction ret;
+    ret.time = std::exp(evaluate(model.weights, x));
+    ret.confidence = std::exp(-model.looError - extrapolation);
+    return ret;
+}
+
+PerfRecord PerfPredictor::predictRecord(const Key &key) const {
+    auto prediction = predict(key);
+    if (prediction.confidence < threshold)
+        return nullptr;
+    return make_ref<PerfRecordObj>(prediction.time);
+}
+
+void PerfPredictor::save(const std::string &file_path) const {
+    std::ofstream fileout(file_path, std::ios::out | std::ios::trunc);
+    json t = *this;
+    fileout << t << std::endl;
+}
+
+void PerfPredictor::load(const std::string &file_path) {
+    std::ifstream filein(file_path, std::ios::in);
+    json j = json::parse(filein);
+    from_json(j, *this);
+}
+
+void to_json(json &j, const PerfPredictor::Model &p) {
+    j = json{{"weights", p.weights},       {"minFeatures", p.minFeatures},
+             {"maxFeatures", p.maxFeatures}, {"looError", p.looError},
+             {"numSamples", p.numSamples}};
+}
+void from_json(const json &j, PerfPredictor::Model &p) {
+    j.at("weights").get_to(p.weights);
+    j.at("minFeatures").get_to(p.minFeatures);
+    j.at("maxFeatures").get_to(p.maxFeatures);
+    j.at("looError").get_to(p.looError);
+    j.at("numSamples").get_to(p.numSamples);
+}
+
+void to_json(json &j, const PerfPredictor &p) {
+    j["threshold"] = p.getConfidenceThreshold();
+    j["models"] = p.getModels();
+}
+void from_json(const json &j, PerfPredictor &p) {
+    p.setConfidenceThreshold(j.at("threshold").get<double>());
+    p.setModels(j.at("models").get<map<PerfPredictor::ModelKey,
+                                        PerfPredictor::Model>>());
+}
+
+} // namespace infini
@@ -0,0 +1,51 @@
+#include "core/run_plan.h"
+
+namespace infini {
+
+template <typename F> static void forEachOperand(const Operator &op, F f) {
+    for (auto &t : op->getInputs())
+        if (t)
+            f(t);
+    for (auto &t : op->getOutputs())
+        if (t)
+            f(t);
+}
+
+static void *dataPtrOf(const Tensor &t) {
+    return t->hasData() ? t->getRawDataPtr<void *>() : nullptr;
+}
+
+RunPlanObj::RunPlanObj(vector<Step> steps_, const vector<size_t> &stepLevels,
+                       size_t perfVersion)
+    : steps(std::move(steps_)), perfVersion(perfVersion) {
+    for (size_t i = 0; i < stepLevels.size(); ++i) {
+        if (stepLevels[i] >= levels.size())
+            levels.resize(stepLevels[i] + 1);
+        levels[stepLevels[i]].emplace_back(i);
+    }
+    for (auto &step : steps)
+        forEachOperand(step.op, [&](const Tensor &t) {
+            operandPtrs.emplace_back(dataPtrOf(t));
+            operandShapes.emplace_back(t->getDims());
+        });
+}
+
+bool RunPlanObj::isValid(const OpVec &ops, size_t perfVersion) const {
+    if (perfVersion != this->perfVersion || ops.size() != steps.size())
+        return false;
+    size_t i = 0;
+    bool valid = true;
+    for (size_t k = 0; k < ops.size() && valid; ++k) {
+        if (ops[k] != steps[k].op)
+            return false;
+        forEachOperand(ops[k], [&](const Tensor &t) {
+            valid = valid && i < operandPtrs.size() &&
+                    operandPtrs[i] == dataPtrOf(t) &&
+                    operandShapes[i] == t->getDims();
+            ++i;
+        });
+    }
+    return valid && i == operandPtrs.size();
+}
+
+} // namespace infini
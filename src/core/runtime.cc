@@ -1,11 +1,18 @@
 #include "core/runtime.h"
 #include "core/blob.h"
+#include "core/cost_model.h"
 #include "core/kernel.h"
 #include "core/perf_engine.h"
+#include "core/run_plan.h"
+#include "core/trace.h"
 #include "utils/data_generator.h"
 #include <chrono>
 #include <cstring>
+#include <exception>
 #include <iostream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace infini {
 PerfMetrics RuntimeObj::getPerfMetrics(const Graph &graph, bool profiling) const {
@@ -27,26 +34,157 @@ PerfMetrics RuntimeObj::getPerfMetrics(const Graph &graph, bool profiling) const
     return metrics;
 }
 
+double RuntimeObj::getPerfScore(const Graph &graph) const {
+    return HeuristicCostModelObj().estimate(graph);
+}
+
 bool RuntimeObj::shouldFuse(const Graph &originalGraph, const Graph &fusedGraph) const {
-    PerfMetrics originalMetrics = getPerfMetrics(originalGraph, false);
-    PerfMetrics fusedMetrics = getPerfMetrics(fusedGraph, false);
-    
-    // 计算总体性能度量，可根据实际需求调整权重
-    double originalScore = originalMetrics.computeTime + 
-                          0.5 * originalMetrics.memoryCost - 
-                          0.2 * originalMetrics.parallelism;
-                          
-    double fusedScore = fusedMetrics.computeTime + 
-                       0.5 * fusedMetrics.memoryCost - 
-                       0.2 * fusedMetrics.parallelism;
-    
     // 分数越小表示性能越好
-    return fusedScore < originalScore;
+    return getPerfScore(fusedGraph) < getPerfScore(originalGraph);
+}
+
+RunPlan CpuRuntimeObj::compile(const Graph &graph) const {
+    const auto &kernelRegistry = KernelRegistry::getInstance();
+    auto &perfEngine = PerfEngine::getInstance();
+    auto perfVersion = perfEngine.getVersion();
+    bool concurrent = graph->isInterOpParallel();
+    if (auto plan = graph->getRunPlan();
+        plan && plan->isValid(graph->getOperators(), perfVersion) &&
+        plan->getLevels().empty() != concurrent)
+        return plan;
+
+    if (concurrent)
+        IT_ASSERT(graph->topo_sort());
+    // Resolve each op as run does without tuning
+    vector<RunPlanObj::Step> steps;
+    for (auto &op : graph->getOperators()) {
+        auto kernelAttrs = KernelAttrs{device, op->getOpType().underlying()};
+        Kernel *kernel = kernelRegistry.getKernel(kernelAttrs);
+        auto perfKey = PerfEngine::Key{kernelAttrs, op->getOpPerfKey()};
+        auto record = perfEngine.getPerfData(perfKey);
+        ComputeFuncPtr func;
+        if (record) {
+            kernel->computeFuncTune(perfKey, op, record, this);
+            func = kernel->getComputeFunc(perfKey);
+        }
+        auto kernelName =
+            std::get<1>(kernelRegistry.getKernelItem(kernelAttrs));
+        steps.push_back({op, kernel, kernelName, record, func});
+    }
+    vector<size_t> stepLevels;
+    if (concurrent)
+        stepLevels = graph->getOpLevels();
+    auto plan =
+        make_ref<RunPlanObj>(std::move(steps), stepLevels, perfVersion);
+    graph->setRunPlan(plan);
+    return plan;
+}
+
+// Run a step, and record it to `tracer` if set
+static void runStep(const RunPlanObj::Step &step, const RuntimeObj *runtime,
+                    Tracer *tracer) {
+    double start = tracer ? tracer->now() : 0;
+    if (step.record)
+        step.func(step.op, step.record, runtime);
+    else
+        step.kernel->compute(step.op, runtime);
+    if (!tracer)
+        return;
+    double end = tracer->now();
+    const auto &op = step.op;
+    size_t bytes = 0;
+    for (auto &t : op->getInputs())
+        if (t)
+            bytes += t->getBytes();
+    for (auto &t : op->getOutputs())
+        if (t)
+            bytes += t->getBytes();
+    tracer->record({string(op->getOpType().toString()) + "#" +
+                        std::to_string(op->getGuid()),
+                    op->getOpType(), step.kernelName, start, end,
+                    Tracer::threadId(), bytes, op->getComputeTime()});
+}
+
+// Run level by level. The steps of a level are OpenMP tasks taken by idle
+// threads of the team, and the parallel loops of each kernel get an equal
+// share of the threads.
+static void runLevels(const RunPlanObj &plan, const RuntimeObj *runtime,
+                      Tracer *tracer) {
+    const auto &steps = plan.getSteps();
+#ifdef _OPENMP
+    const int maxThreads = omp_get_max_threads();
+    // kernels open their parallel regions inside the tasks
+    const int maxActiveLevels = omp_get_max_active_levels();
+    omp_set_max_active_levels(std::max(maxActiveLevels, 2));
+#else
+    const int maxThreads = 1;
+#endif
+    std::exception_ptr error = nullptr;
+    for (auto &level : plan.getLevels()) {
+        const int width = level.size();
+        if (width == 1 || maxThreads == 1) {
+            for (auto i : level)
+                runStep(steps[i], runtime, tracer);
+            continue;
+        }
+        [[maybe_unused]] const int budget = std::max(1, maxThreads / width);
+#pragma omp parallel num_threads(std::min(width, maxThreads))
+#pragma omp single
+        for (auto i : level) {
+#pragma omp task firstprivate(i) shared(error)
+            {
+#ifdef _OPENMP
+                omp_set_num_threads(budget);
+#endif
+                try {
+                    runStep(steps[i], runtime, tracer);
+                } catch (...) {
+#pragma omp critical
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+        }
+        if (error)
+            break;
+    }
+#ifdef _OPENMP
+    omp_set_max_active_levels(maxActiveLevels);
+#endif
+    if (error)
+        std::rethrow_exception(error);
 }
 
 void CpuRuntimeObj::run(const Graph &graph, bool tune, bool profiling) const {
-    if (!tune && profiling)
-        IT_TODO_HALT();
+    if (!tune) {
+        auto plan = compile(graph);
+        // a profiling run traces into its own tracer and prints the events
+        Tracer profiler;
+        auto &globalTracer = Tracer::getInstance();
+        Tracer *tracer = profiling                  ? &profiler
+                         : globalTracer.isEnabled() ? &globalTracer
+                                                    : nullptr;
+        if (!plan->getLevels().empty())
+            runLevels(*plan, this, tracer);
+        else
+            for (auto &step : plan->getSteps())
+                runStep(step, this, tracer);
+        if (profiling) {
+            double totalTime = 0;
+            std::map<OpType, double> opTime;
+            std::map<OpType, int> opCnt;
+            for (auto &e : profiler.getEvents()) {
+                double t = (e.end - e.start) / 1000;
+                printf("%s (%s) op_time %lf\n", e.name.c_str(),
+                       e.kernel.c_str(), t);
+                totalTime += t;
+                opTime[e.type] += t;
+                opCnt[e.type]++;
+            }
+            printProfilingData(totalTime, opTime, opCnt);
+        }
+        return;
+    }
     const auto &kernelRegistry = KernelRegistry::getInstance();
     auto &perfEngine = PerfEngine::getInstance();
     // Statistics
@@ -60,12 +198,6 @@ void CpuRuntimeObj::run(const Graph &graph, bool tune, bool profiling) const {
         auto perfKey = PerfEngine::Key{kernelAttrs, op->getOpPerfKey()};
         auto perfData = perfEngine.getPerfData(perfKey);
 
-        // If no record and disable tuning, run with the default argument
-        if (!perfData && !tune) {
-            kernel->compute(op, this);
-            continue;
-        }
-
         // TODO: The copy of record should be eliminated
         PerfRecord record;
         // Tune the kernel if there is no record
@@ -109,34 +241,36 @@ double RuntimeObj::getPerfTime(const Graph &graph, bool profiling) const {
         auto kernelAttrs = KernelAttrs{device, op->getOpType().underlying()};
         Kernel *kernel = kernelRegistry.getKernel(kernelAttrs);
         auto perfKey = PerfEngine::Key{kernelAttrs, op->getOpPerfKey()};
-        auto perfData = perfEngine.getPerfData(perfKey);
+        // Predict the time of unseen workloads if possible, and tune the
+        // kernel if there is neither a record nor a confident prediction
+        PerfRecord record = perfEngine.getPerfData(perfKey);
+        if (!record)
+            record = perfEngine.predictPerfData(perfKey);
+        if (!record)
+            record = perfEngine.getOrTunePerfData(perfKey, [&]() {
+                // TODO: should tenosrs automatically allocate when access
+                // data? allocate memory for empty tensors and release it after
+                // profiling
+                TensorVec allocatedTensors;
+                for (auto t : op->getInputs())
+                    if (!t->hasData())
+                        allocatedTensors.emplace_back(t);
+                for (auto t : op->getOutputs())
+                    if (!t->hasData())
+                        allocatedTensors.emplace_back(t);
+                for (auto t : allocatedTensors) {
+                    t->dataMalloc();
+                    t->setData(IncrementalGenerator());
+                }
 
-        PerfRecord record;
-        // Tune the kernel if there is no record
-        if (!perfData) {
-            // TODO: should tenosrs automatically allocate when access data?
-            // allocate memory for empty tensors and release it after profiling
-            TensorVec allocatedTensors;
-            for (auto t : op->getInputs())
-                if (!t->hasData())
-                    allocatedTensors.emplace_back(t);
-            for (auto t : op->getOutputs())
-                if (!t->hasData())
-                    allocatedTensors.emplace_back(t);
-            for (auto t : allocatedTensors) {
-                t->dataMalloc();
-                t->setData(IncrementalGenerator());
-            }
+                // Profile operators and record the results
+                PerfRecord record = kernel->tune(op, this);
 
-            // Profile operators and record the results
-            record = kernel->tune(op, this);
-            perfEngine.setPerfData(perfKey, record);
-
-            // Free allocated memory
-            for (auto t : allocatedTensors)
-                t->freeData();
-        } else
-            record = perfData;
+                // Free allocated memory
+                for (auto t : allocatedTensors)
+                    t->freeData();
+                return record;
+            });
 
         double t = record->time;
         totalTime += t;
@@ -152,6 +286,22 @@ double RuntimeObj::getPerfTime(const Graph &graph, bool profiling) const {
     return totalTime;
 }
 
+std::optional<double> RuntimeObj::getKnownPerfTime(const Graph &graph) const {
+    auto &perfEngine = PerfEngine::getInstance();
+    double totalTime = 0;
+    for (auto &op : graph->getOperators()) {
+        auto kernelAttrs = KernelAttrs{device, op->getOpType().underlying()};
+        auto perfKey = PerfEngine::Key{kernelAttrs, op->getOpPerfKey()};
+        PerfRecord record = perfEngine.getPerfData(perfKey);
+        if (!record)
+            record = perfEngine.predictPerfData(perfKey);
+        if (!record)
+            return std::nullopt;
+        totalTime += record->time;
+    }
+    return totalTime;
+}
+
 void RuntimeObj::printProfilingData(double totalTime,
                                     const std::map<OpType, double> &opTime,
                                     const std::map<OpType, int> &opCnt) const {
@@ -163,7 +313,7 @@ void RuntimeObj::printProfilingData(double totalTime,
 }
 
 Blob RuntimeObj::allocBlob(size_t size) {
-    return make_ref<BlobObj>(shared_from_this(), alloc(size));
+    return make_ref<BlobObj>(shared_from_this(), alloc(size), true);
 }
 
 void RuntimeObj::copyBlob(const TensorObj *dst, const TensorObj *src) const {
@@ -3,11 +3,39 @@
 #include "core/runtime.h"
 
 #include <algorithm>
+#include <exception>
 #include <iostream>
 #include <unordered_set>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace infini {
 
+namespace {
+// Run func(i) for each i in [0, n) on an OpenMP thread team. Exceptions can
+// not leave an OpenMP region, so the first one is rethrown after the loop.
+template <typename F> void parallelFor(size_t n, int numThreads, F &&func) {
+    std::exception_ptr error = nullptr;
+#ifdef _OPENMP
+    if (numThreads <= 0)
+        numThreads = omp_get_max_threads();
+#endif
+#pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+    for (size_t i = 0; i < n; i++) {
+        try {
+            func(i);
+        } catch (...) {
+#pragma omp critical
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+} // namespace
+
 void SearchEngine::printMetaGraph(Ref<SearchEngine::MetaGraph> metaGraph) {
     for (size_t i = 0; i < metaGraph->nodes.size(); i++) {
         auto &node = metaGraph->nodes[i];
@@ -28,16 +56,94 @@ void SearchEngine::printMetaGraph(Ref<SearchEngine::MetaGraph> metaGraph) {
     std::cout << std::endl;
 }
 
+void SearchEngine::clearCostCache() {
+    perfTimeCache.clear();
+    perfScoreCache.clear();
+    numCostEvaluations = 0;
+}
+
+double SearchEngine::getPerfTime(const Graph &graph) {
+    auto it = perfTimeCache.find(graph->getGuid());
+    if (it != perfTimeCache.end())
+        return it->second;
+    numCostEvaluations++;
+    double t = runtimeExec->getPerfTime(graph);
+    perfTimeCache.emplace(graph->getGuid(), t);
+    return t;
+}
+
+double SearchEngine::getPerfScore(const Graph &graph) {
+    auto it = perfScoreCache.find(graph->getGuid());
+    if (it != perfScoreCache.end())
+        return it->second;
+    numCostEvaluations++;
+    double score = costModel->estimate(graph);
+    perfScoreCache.emplace(graph->getGuid(), score);
+    return score;
+}
+
+void SearchEngine::sortByCost(std::vector<Graph> &graphs,
+                              double (SearchEngine::*cost)(const Graph &)) {
+    std::vector<std::pair<double, Graph>> keyed;
+    keyed.reserve(graphs.size());
+    for (auto &g : graphs)
+        keyed.emplace_back((this->*cost)(g), g);
+    std::stable_sort(keyed.begin(), keyed.end(),
+                     [](const auto &x, const auto &y) {
+                         return x.first < y.first;
+                     });
+    for (size_t i = 0; i < graphs.size(); i++)
+        graphs[i] = std::move(keyed[i].second);
+}
+
+std::vector<Graph>
+SearchEngine::buildCandidates(const std::vector<OpVec> &opLists) {
+    std::vector<Graph> graphs(opLists.size());
+    std::vector<std::optional<double>> perfTimes(opLists.size());
+    parallelFor(opLists.size(), numThreads, [&](size_t i) {
+        auto graph = make_ref<GraphObj>(runtimeExec, opLists[i], false);
+        graph->dataMalloc();
+        perfTimes[i] = runtimeExec->getKnownPerfTime(graph);
+        graphs[i] = graph;
+    });
+    // Unseen workloads are tuned after the join, so that kernels are timed
+    // with all the threads they would run on
+    for (size_t i = 0; i < graphs.size(); i++) {
+        if (!perfTimes[i])
+            perfTimes[i] = runtimeExec->getPerfTime(graphs[i]);
+        perfTimeCache.emplace(graphs[i]->getGuid(), *perfTimes[i]);
+    }
+    numCostEvaluations += graphs.size();
+    return graphs;
+}
+
 Graph SearchEngine::run(const Graph graph) {
     IT_ASSERT(runtimeExec == graph->getRuntime());
+    clearCostCache();
     std::cout << "[INFO] original graph: " << std::endl;
     std::cout << graph->toString();
-    std::cout << "[INFO] perf: " << runtimeExec->getPerfTime(graph)
-              << std::endl;
+    std::cout << "[INFO] perf: " << getPerfTime(graph) << std::endl;
 
     std::vector<Graph> partitions = partitionGraph(graph);
 
     std::cout << "[INFO] Partition num: " << partitions.size() << std::endl;
+    if (useBeamSearch) {
+        Beam beam = {nullptr};
+        for (size_t pid = 0; pid < partitions.size(); pid++) {
+            std::cout << "[INFO] Partition: " << pid << std::endl;
+            std::vector<Graph> candidates = search(partitions[pid]);
+            std::cout << "[INFO] size: " << candidates.size() << std::endl;
+            IT_ASSERT(candidates.size() > 0);
+            beam = extendBeam(beam, candidates);
+        }
+        for (size_t i = 0; i < beam.size(); i++) {
+            std::cout << "[INFO] beam " << i << " perf: " << beam[i]->cost
+                      << std::endl;
+        }
+        std::cout << "[INFO] cost evaluations: " << numCostEvaluations
+                  << std::endl;
+        return materialize(beam[0]);
+    }
     std::vector<Graph> bestGraphs = {nullptr};
     for (size_t pid = 0; pid < partitions.size(); pid++) {
         auto &subGraph = partitions[pid];
@@ -46,7 +152,7 @@ Graph SearchEngine::run(const Graph graph) {
         std::cout << "[INFO] size: " << candidates.size() << std::endl;
         IT_ASSERT(candidates.size() > 0);
         std::cout << subGraph->toString() << std::endl;
-        std::vector<Graph> nextGraphs;
+        std::vector<OpVec> nextOpLists;
         for (auto lastGraph : bestGraphs) {
             for (auto thisGraph : candidates) {
                 std::vector<Operator> ops;
@@ -60,14 +166,11 @@ Graph SearchEngine::run(const Graph graph) {
                         ops.emplace_back(op);
                     }
                 }
-                auto tmp = make_ref<GraphObj>(runtimeExec, ops);
-                tmp->dataMalloc();
-                nextGraphs.emplace_back(tmp);
+                nextOpLists.emplace_back(std::move(ops));
             }
         }
-        std::sort(nextGraphs.begin(), nextGraphs.end(), [&](Graph x, Graph y) {
-            return runtimeExec->getPerfTime(x) < runtimeExec->getPerfTime(y);
-        });
+        std::vector<Graph> nextGraphs = buildCandidates(nextOpLists);
+        sortByCost(nextGraphs, &SearchEngine::getPerfTime);
         if (nextGraphs.size() > GRAPH_SIZE) {
             nextGraphs.resize(GRAPH_SIZE);
         }
@@ -81,9 +184,11 @@ Graph SearchEngine::run(const Graph graph) {
     for (size_t i = 0; i < bestGraphs.size(); i++) {
         std::cout << "bestGraph " << i << ":" << std::endl;
         std::cout << bestGraphs[i]->toString();
-        std::cout << "[INFO] perf: " << runtimeExec->getPerfTime(bestGraphs[i])
+        std::cout << "[INFO] perf: " << getPerfTime(bestGraphs[i])
                   << std::endl;
     }
+    std::cout << "[INFO] cost evaluations: " << numCostEvaluations
+              << std::endl;
 
     return bestGraphs[0];
 }
@@ -95,10 +200,11 @@ std::vector<Graph> SearchEngine::search(const Graph &graph) {
 
     std::vector<Graph> results;
     for (auto mergedGraph : mergedGraphs) {
-        auto mutatedGraphs = searchMutation(mergedGraph);
+        auto mutatedGraphs = useBeamSearch ? searchMutationBeam(mergedGraph)
+                                           : searchMutation(mergedGraph);
         for (auto &mutatedGraph : mutatedGraphs) {
             // 使用启发式函数判断是否应该融合
-            if (runtimeExec->shouldFuse(graph, mutatedGraph)) {
+            if (getPerfScore(mutatedGraph) < getPerfScore(graph)) {
                 results.push_back(mutatedGraph);
             } else {
                 // 如果启发式判断不应该融合，但是是局部最优解，也可以保留
@@ -110,20 +216,8 @@ std::vector<Graph> SearchEngine::search(const Graph &graph) {
         }
     }
 
-    // 按性能指标排序，性能最好的放在前面
-    std::sort(results.begin(), results.end(),
-        [this](const Graph &x, const Graph &y) {
-            // 获取综合性能指标
-            PerfMetrics mX = runtimeExec->getPerfMetrics(x, false);
-            PerfMetrics mY = runtimeExec->getPerfMetrics(y, false);
-            
-            // 计算性能总分（分数越小越好）
-            // 计算时间权重最大，内存成本次之，并行度可以提高性能所以为负权重
-            double scoreX = mX.computeTime + 0.5 * mX.memoryCost - 0.2 * mX.parallelism;
-            double scoreY = mY.computeTime + 0.5 * mY.memoryCost - 0.2 * mY.parallelism;
-            
-            return scoreX < scoreY;
-        });
+    // 按性能指标排序，性能最好的放在前面（分数越小越好）
+    sortByCost(results, &SearchEngine::getPerfScore);
 
     // 保留前GRAPH_SIZE个最优结果
     if (results.size() > GRAPH_SIZE) {
@@ -131,6 +225,7 @@ std::vector<Graph> SearchEngine::search(const Graph &graph) {
     }
     
     // 输出最优解的性能指标，便于调试
+    std::cout << "[INFO] Cost model: " << costModel->toString() << std::endl;
     if (!results.empty()) {
         auto bestMetrics = runtimeExec->getPerfMetrics(results[0], false);
         std::cout << "[INFO] Best solution metrics - "
@@ -157,7 +252,7 @@ SearchEngine::buildMetaGraphWithGraph(const Graph graph) {
         MetaGraph::Node node;
         std::vector<Operator> ops;
         ops.emplace_back(op);
-        node.graph = make_ref<GraphObj>(runtimeExec, ops);
+        node.graph = make_ref<GraphObj>(runtimeExec, ops, false);
         node.type = op->getOpType().isMatMulOrConv();
         node.cnt = op->getPredecessors().size();
         opMap.emplace(op->getGuid(), i);
@@ -225,7 +320,7 @@ std::shared_ptr<SearchEngine::MetaGraph> SearchEngine::buildMetaGraphWithPlan(
                     preSet.emplace(plan[pre]);
                 }
             }
-            node.graph = make_ref<GraphObj>(runtimeExec, ops);
+            node.graph = make_ref<GraphObj>(runtimeExec, ops, false);
             node.cnt = node.pre.size();
             node.type = ops[0]->getOpType().isMatMulOrConv();
             resultMetaGraph->nodes.emplace_back(node);
@@ -340,7 +435,7 @@ void SearchEngine::searchMergeDfs(std::shared_ptr<MetaGraph> &metaGraph,
                 nextFrontier.emplace_back(frontier[i]);
             }
         }
-        auto graph = make_ref<GraphObj>(runtimeExec, ops);
+        auto graph = make_ref<GraphObj>(runtimeExec, ops, false);
         if (ops.size() == 1 || isMultiBranchMergable(graph)) {
             searchMergeDfs(metaGraph, plan, nextFrontier, plans, planSet);
         }
@@ -356,7 +451,7 @@ std::vector<Graph> SearchEngine::searchMutation(
     std::vector<Graph> graphs = {nullptr};
     // Append a node to all existing candidates
     for (auto &node : metaGraph->nodes) {
-        std::vector<Graph> nextGraphs;
+        std::vector<OpVec> nextOpLists;
         if (node.type == 1) { // If it has computing OPs
             auto mutatedGraphs = mutator->run(node.graph);
             for (auto graph : graphs) {
@@ -370,8 +465,7 @@ std::vector<Graph> SearchEngine::searchMutation(
                     for (auto op : mutatedGraph->getOperators()) {
                         ops.emplace_back(op);
                     }
-                    nextGraphs.emplace_back(
-                        make_ref<GraphObj>(runtimeExec, ops));
+                    nextOpLists.emplace_back(std::move(ops));
                 }
             }
         } else {
@@ -385,15 +479,11 @@ std::vector<Graph> SearchEngine::searchMutation(
                 for (auto op : node.graph->getOperators()) {
                     ops.emplace_back(op);
                 }
-                nextGraphs.emplace_back(make_ref<GraphObj>(runtimeExec, ops));
+                nextOpLists.emplace_back(std::move(ops));
             }
         }
-        for (auto g : nextGraphs) {
-            g->dataMalloc();
-        }
-        std::sort(nextGraphs.begin(), nextGraphs.end(), [&](Graph x, Graph y) {
-            return runtimeExec->getPerfTime(x) < runtimeExec->getPerfTime(y);
-        });
+        std::vector<Graph> nextGraphs = buildCandidates(nextOpLists);
+        sortByCost(nextGraphs, &SearchEngine::getPerfTime);
         if (nextGraphs.size() > GRAPH_SIZE) {
             nextGraphs.resize(GRAPH_SIZE);
         }
@@ -402,6 +492,67 @@ std::vector<Graph> SearchEngine::searchMutation(
     return graphs;
 }
 
+// Beam search version of searchMutation. Only the final beam is materialized.
+std::vector<Graph> SearchEngine::searchMutationBeam(
+    const std::shared_ptr<SearchEngine::MetaGraph> &metaGraph) {
+    Beam beam = {nullptr};
+    for (auto &node : metaGraph->nodes) {
+        if (node.type == 1) { // If it has computing OPs
+            beam = extendBeam(beam, mutator->run(node.graph));
+        } else {
+            beam = extendBeam(beam, {node.graph});
+        }
+    }
+    std::vector<Graph> graphs(beam.size());
+    parallelFor(beam.size(), numThreads,
+                [&](size_t i) { graphs[i] = materialize(beam[i]); });
+    for (size_t i = 0; i < beam.size(); i++)
+        perfTimeCache.emplace(graphs[i]->getGuid(), beam[i]->cost);
+    return graphs;
+}
+
+SearchEngine::Beam
+SearchEngine::extendBeam(const Beam &beam, const std::vector<Graph> &segments) {
+    std::vector<double> segmentCosts;
+    for (auto &segment : segments)
+        segmentCosts.emplace_back(getPerfTime(segment));
+    // (cost, index in beam, index in segments)
+    std::vector<std::tuple<double, size_t, size_t>> extensions;
+    for (size_t i = 0; i < beam.size(); i++) {
+        double base = beam[i] ? beam[i]->cost : 0;
+        for (size_t j = 0; j < segments.size(); j++)
+            extensions.emplace_back(base + segmentCosts[j], i, j);
+    }
+    std::stable_sort(extensions.begin(), extensions.end(),
+                     [](const auto &x, const auto &y) {
+                         return std::get<0>(x) < std::get<0>(y);
+                     });
+    if (extensions.size() > beamWidth) {
+        extensions.resize(beamWidth);
+    }
+    Beam nextBeam;
+    for (auto &[cost, i, j] : extensions) {
+        nextBeam.emplace_back(std::make_shared<const BeamEntry>(
+            BeamEntry{beam[i], segments[j], cost}));
+    }
+    return nextBeam;
+}
+
+Graph SearchEngine::materialize(const std::shared_ptr<const BeamEntry> &entry) {
+    std::vector<Graph> chain;
+    for (auto e = entry.get(); e != nullptr; e = e->prev.get())
+        chain.emplace_back(e->segment);
+    std::vector<Operator> ops;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        for (auto op : (*it)->getOperators()) {
+            ops.emplace_back(op);
+        }
+    }
+    auto graph = make_ref<GraphObj>(runtimeExec, ops, false);
+    graph->dataMalloc();
+    return graph;
+}
+
 bool SearchEngine::isMultiBranchMergable(const Graph graph) {
     return mutationEngine->isMultiBranchMergable(graph);
 }
@@ -453,7 +604,7 @@ std::vector<Graph> SearchEngine::partitionGraph(const Graph graph) {
             for (auto op : headOps) {
                 std::cout << op->toString() << std::endl;
             }
-            auto tmp = make_ref<GraphObj>(runtimeExec, headOps);
+            auto tmp = make_ref<GraphObj>(runtimeExec, headOps, false);
             tmp->dataMalloc();
             partitions.emplace_back(tmp);
             headOps.clear();
@@ -461,7 +612,7 @@ std::vector<Graph> SearchEngine::partitionGraph(const Graph graph) {
     fail:;
     }
     if (!headOps.empty()) {
-        auto tmp = make_ref<GraphObj>(runtimeExec, headOps);
+        auto tmp = make_ref<GraphObj>(runtimeExec, headOps, false);
         tmp->dataMalloc();
         partitions.emplace_back(tmp);
     }
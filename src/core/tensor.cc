@@ -168,12 +168,14 @@ void TensorObj::dataMalloc() {
 void TensorObj::copyData(const TensorObj *src) {
     IT_ASSERT(dtype == src->getDType());
     IT_ASSERT(size() == src->size());
+    detachData();
     runtime->copyBlob(this, src);
 }
 
 void TensorObj::setData(
-    const std::function<void(void *, size_t, DataType)> &generator) const {
+    const std::function<void(void *, size_t, DataType)> &generator) {
     IT_ASSERT(data != nullptr);
+    detachData();
     if (runtime->isCpu()) {
         generator(getRawDataPtr<void *>(), size(), dtype);
     } else {
@@ -189,6 +191,14 @@ void TensorObj::setData(
 
 void TensorObj::setDataBlob(const Blob &blob) { this->data = blob; }
 
+void TensorObj::detachData() {
+    if (!isDataShared())
+        return;
+    TensorObj shared(*this);
+    data = runtime->allocBlob(getBytes());
+    runtime->copyBlob(this, &shared);
+}
+
 void TensorObj::load(std::string file_path) { loadTensorData(this, file_path); }
 
 void TensorObj::save(std::string file_path) { saveTensorData(this, file_path); }
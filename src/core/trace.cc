@@ -0,0 +1,66 @@
+#include "core/trace.h"
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+namespace infini {
+
+void Tracer::clear() {
+    std::lock_guard lock(mutex);
+    events.clear();
+    epoch = std::chrono::steady_clock::now();
+}
+
+double Tracer::now() const {
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now() - epoch)
+        .count();
+}
+
+int Tracer::threadId() {
+    static std::atomic<int> nextId{0};
+    thread_local int id = nextId++;
+    return id;
+}
+
+void Tracer::record(TraceEvent event) {
+    std::lock_guard lock(mutex);
+    events.emplace_back(std::move(event));
+}
+
+vector<TraceEvent> Tracer::getEvents() const {
+    std::lock_guard lock(mutex);
+    return events;
+}
+
+void Tracer::exportChromeTrace(const string &path) const {
+    nlohmann::json trace = nlohmann::json::array();
+    for (auto &e : getEvents())
+        trace.push_back({{"name", e.name},
+                         {"cat", e.type.toString()},
+                         {"ph", "X"},
+                         {"ts", e.start},
+                         {"dur", e.end - e.start},
+                         {"pid", 0},
+                         {"tid", e.thread},
+                         {"args",
+                          {{"kernel", e.kernel},
+                           {"bytes", e.bytes},
+                           {"estimated_time", e.estimatedTime}}}});
+    std::ofstream file(path);
+    IT_ASSERT(file.good(), "Failed to open " + path);
+    file << nlohmann::json{{"traceEvents", trace},
+                           {"displayTimeUnit", "ms"}};
+}
+
+void Tracer::exportCsv(const string &path) const {
+    std::ofstream file(path);
+    IT_ASSERT(file.good(), "Failed to open " + path);
+    file << "name,type,kernel,thread,start_us,duration_us,bytes,"
+            "estimated_time\n";
+    for (auto &e : getEvents())
+        file << e.name << "," << e.type.toString() << "," << e.kernel << ","
+             << e.thread << "," << e.start << "," << e.end - e.start << ","
+             << e.bytes << "," << e.estimatedTime << "\n";
+}
+
+} // namespace infini
@@ -1,5 +1,6 @@
 #include "core/data_type.h"
 #include "core/graph_handler.h"
+#include "core/trace.h"
 #include "operators/batch_norm.h"
 #include "operators/concat.h"
 #include "operators/conv.h"
@@ -73,6 +74,12 @@ void export_values(py::module &m) {
         .VALUE(ActType, Tanh)
         .export_values();
 
+    py::enum_<MemPlanStrategy>(m, "MemPlanStrategy")
+        .VALUE(MemPlanStrategy, Online)
+        .VALUE(MemPlanStrategy, GreedyBySize)
+        .VALUE(MemPlanStrategy, GreedyByBreadth)
+        .export_values();
+
     py::class_<OpType>(m, "OpType")
         .def(py::init<decltype(OpType::type)>())
         .def("id", getId, policy::automatic);
@@ -346,6 +353,20 @@ static std::tuple<float, float, float, int> lrn_attrs_of(Operator op) {
     return std::make_tuple(alpha, beta, bias, size);
 }
 
+static void set_tracing(bool enable) {
+    Tracer::getInstance().setEnabled(enable);
+}
+
+static void clear_trace() { Tracer::getInstance().clear(); }
+
+static void export_chrome_trace(const std::string &path) {
+    Tracer::getInstance().exportChromeTrace(path);
+}
+
+static void export_trace_csv(const std::string &path) {
+    Tracer::getInstance().exportCsv(path);
+}
+
 void export_functions(py::module &m) {
 #define FUNCTION(NAME) def(#NAME, &NAME)
     m.def("cpu_runtime", &NativeCpuRuntimeObj::getInstance)
@@ -390,7 +411,11 @@ void export_functions(py::module &m) {
         .FUNCTION(squeeze_axes_of)
         .FUNCTION(unsqueeze_axes_of)
         .FUNCTION(lrn_attrs_of)
-        .FUNCTION(elu_alpha_of);
+        .FUNCTION(elu_alpha_of)
+        .FUNCTION(set_tracing)
+        .FUNCTION(clear_trace)
+        .FUNCTION(export_chrome_trace)
+        .FUNCTION(export_trace_csv);
 #undef FUNCTION
 }
 
@@ -604,6 +629,17 @@ void init_graph_builder(py::module &m) {
         .def("data_malloc", &Handler::data_malloc,
              py::arg("useNaiveAllocator") = false, py::arg("memPoolSize") = 0,
              policy::automatic)
+        .def("set_mem_plan_strategy", &Handler::set_mem_plan_strategy,
+             policy::automatic)
+        .def("set_inplace_planning", &Handler::set_inplace_planning,
+             policy::automatic)
+        .def("set_inter_op_parallel", &Handler::set_inter_op_parallel,
+             policy::automatic)
+        .def("set_weight_file", &Handler::set_weight_file, policy::automatic)
+        .def("save_weights", &Handler::save_weights, policy::automatic)
+        .def("get_mem_peak", &Handler::get_mem_peak, policy::automatic)
+        .def("get_mem_lower_bound", &Handler::get_mem_lower_bound,
+             policy::automatic)
         .def("clone_KV", &Handler::clone_KV, policy::move)
         .def("free_heap", &Handler::free_heap, policy::move)
         .def("get_perf_time", &Handler::get_perf_time, policy::automatic)
@@ -12,6 +12,8 @@ class CopyAclnn : public ASCENDKernelWithoutConfig {
 
         void *const aData = (op->getInputs(0)->getRawDataPtr<void *>());
         void *const cData = (op->getOutput()->getRawDataPtr<void *>());
+        if (cData == aData)
+            return;
 
         auto aD = op->getInputs(0)->getDims();
         auto aS = op->getInputs(0)->getStride();
@@ -9,6 +9,8 @@ class CopyBang : public BangKernelWithoutConfig {
         auto context = dynamic_cast<const BangRuntimeObj *>(_context);
         auto inData = op->getInputs(0)->getRawDataPtr<void *>();
         auto outData = op->getOutputs()[0]->getRawDataPtr<void *>();
+        if (outData == inData)
+            return;
         cnnlTensorDescriptor_t aDesc;
         auto dim = op->getInputs(0)->getDims();
 
@@ -1,61 +1,406 @@
 #include "operators/conv.h"
 #include "core/kernel.h"
+#include "cpu/gemm.h"
 
 namespace infini {
 
-class NaiveConv : public CpuKernelWithoutConfig {
-    template <typename T>
-    void doCompute(const Operator &_op, const RuntimeObj *context) const {
-        auto op = as<ConvObj>(_op);
-        T *iptr = op->getInputs(0)->getRawDataPtr<T *>();
-        T *wptr = op->getInputs(1)->getRawDataPtr<T *>();
-        T *optr = op->getOutput()->getRawDataPtr<T *>();
-        //  Clang will give an error of " reference to local binding 'sh'
-        //  declared in enclosing function" if we write like this:
-        //        auto [n, c, h, w, f, r, s] = op->getNCHWFRS();
-        int n, c, h, w, f, r, s;
+namespace {
+// The index of an algorithm is stored in perf records, so new ones are
+// appended
+enum class ConvAlgo {
+    Direct,
+    Im2col,
+    Pointwise,
+    Depthwise,
+    Winograd,
+    Winograd4x4
+};
+constexpr ConvAlgo allConvAlgos[] = {
+    ConvAlgo::Direct,    ConvAlgo::Im2col,   ConvAlgo::Pointwise,
+    ConvAlgo::Depthwise, ConvAlgo::Winograd, ConvAlgo::Winograd4x4};
+
+struct ConvParams {
+    int n, c, h, w, f, r, s;
+    int ph, pw, sh, sw, dh, dw;
+    int g, cpg, fpg, oh, ow;
+    ActType act;
+
+    explicit ConvParams(const Ref<ConvObj> &op) {
         std::tie(n, c, h, w, f, r, s) = op->getNCHWFRS();
-        int ph, pw, sh, sw, dh, dw;
         std::tie(ph, pw, sh, sw, dh, dw) = op->getPadStrideDilation();
-        int cpg = op->getChannelPerGroup();
-        int g = op->getNumGroups();
+        cpg = op->getChannelPerGroup();
+        g = op->getNumGroups();
         IT_ASSERT(f % g == 0, "Illegal number of channel");
+        fpg = f / g;
         auto outDim = op->getOutput()->getDims();
-        int oh = outDim[2], ow = outDim[3];
-        for (int nn = 0; nn < n; nn++) {
+        oh = outDim[2], ow = outDim[3];
+        act = op->getAct();
+    }
+};
+
+bool isApplicable(ConvAlgo algo, const ConvParams &p, DataType dtype) {
+    switch (algo) {
+    case ConvAlgo::Direct:
+    case ConvAlgo::Im2col:
+        return true;
+    case ConvAlgo::Pointwise:
+        return p.r == 1 && p.s == 1 && p.sh == 1 && p.sw == 1 && p.ph == 0 &&
+               p.pw == 0;
+    case ConvAlgo::Depthwise:
+        return p.cpg == 1 && p.fpg == 1;
+    case ConvAlgo::Winograd:
+    case ConvAlgo::Winograd4x4:
+        return dtype == DataType::Float32 && p.g == 1 && p.r == 3 &&
+               p.s == 3 && p.sh == 1 && p.sw == 1 && p.dh == 1 && p.dw == 1;
+    }
+    return false;
+}
+
+template <typename T> void activateAll(T *ptr, size_t size, ActType act) {
+    if (act == ActType::None)
+        return;
+#pragma omp parallel for
+    for (size_t i = 0; i < size; ++i)
+        ptr[i] = activate(ptr[i], act);
+}
+
+// Reference loop nest, which supports everything
+template <typename T>
+void convDirect(const ConvParams &p, const T *iptr, const T *wptr, T *optr) {
+    for (int nn = 0; nn < p.n; nn++) {
 #pragma omp parallel for
-            for (int ff = 0; ff < f; ff++) {
-                for (int hh = 0; hh < oh; hh++)
-                    for (int ww = 0; ww < ow; ww++) {
-                        int gidx = ff / (f / g);
-                        T val = 0;
-                        for (int cc = 0; cc < cpg; cc++)
-                            for (int rr = 0; rr < r; rr++)
-                                for (int ss = 0; ss < s; ss++) {
-                                    // clang-format off
-                                int posH = hh * sh + rr * dh - ph;
-                                int posW = ww * sw + ss * dw - pw;
-                                if (posH < 0 || posH >= h || posW < 0 || posW >= w)
+        for (int ff = 0; ff < p.f; ff++) {
+            int gidx = ff / p.fpg;
+            for (int hh = 0; hh < p.oh; hh++)
+                for (int ww = 0; ww < p.ow; ww++) {
+                    T val = 0;
+                    for (int cc = 0; cc < p.cpg; cc++)
+                        for (int rr = 0; rr < p.r; rr++)
+                            for (int ss = 0; ss < p.s; ss++) {
+                                int posH = hh * p.sh + rr * p.dh - p.ph;
+                                int posW = ww * p.sw + ss * p.dw - p.pw;
+                                if (posH < 0 || posH >= p.h || posW < 0 ||
+                                    posW >= p.w)
                                     continue;
-                                auto iOffset = posW + w * (posH + h * ((cc + gidx * cpg) + c * nn)),
-                                    wOffset = ss + s * (rr + r * (cc + cpg * ff));
-                                auto inputVal = iptr[iOffset], weightVal = wptr[wOffset];
-                                val += weightVal * inputVal;
-                                    // clang-format on
-                                }
-                        // TODO: check correctness, oh & ow or h & w?
-                        auto oOffset = ww + ow * (hh + oh * (ff + f * nn));
-                        optr[oOffset] = val;
+                                size_t iOffset =
+                                    posW +
+                                    p.w * (posH + p.h * ((cc + gidx * p.cpg) +
+                                                         p.c * nn));
+                                size_t wOffset =
+                                    ss + p.s * (rr + p.r * (cc + p.cpg * ff));
+                                val += wptr[wOffset] * iptr[iOffset];
+                            }
+                    size_t oOffset = ww + p.ow * (hh + p.oh * (ff + p.f * nn));
+                    optr[oOffset] = activate(val, p.act);
+                }
+        }
+    }
+}
+
+// Unfold the receptive fields of each image into a (cpg * r * s) x (oh * ow)
+// matrix per group, and multiply it by the weights with cpuGemm
+template <typename T>
+void convIm2col(const ConvParams &p, const T *iptr, const T *wptr, T *optr) {
+    const int K = p.cpg * p.r * p.s, P = p.oh * p.ow;
+    vector<T> col((size_t)p.g * K * P);
+    vector<size_t> offsetsW(p.g), offsetsCol(p.g), offsetsOut(p.g);
+    for (int gi = 0; gi < p.g; ++gi) {
+        offsetsW[gi] = (size_t)gi * p.fpg * K;
+        offsetsCol[gi] = (size_t)gi * K * P;
+    }
+    for (int nn = 0; nn < p.n; ++nn) {
+        const T *image = iptr + (size_t)nn * p.c * p.h * p.w;
+#pragma omp parallel for collapse(2)
+        for (int cc = 0; cc < p.c; ++cc)
+            for (int rs = 0; rs < p.r * p.s; ++rs) {
+                int rr = rs / p.s, ss = rs % p.s;
+                T *dst = col.data() + ((size_t)cc * p.r * p.s + rs) * P;
+                const T *src = image + (size_t)cc * p.h * p.w;
+                for (int hh = 0; hh < p.oh; ++hh) {
+                    int posH = hh * p.sh + rr * p.dh - p.ph;
+                    for (int ww = 0; ww < p.ow; ++ww) {
+                        int posW = ww * p.sw + ss * p.dw - p.pw;
+                        *dst++ = posH < 0 || posH >= p.h || posW < 0 ||
+                                         posW >= p.w
+                                     ? T(0)
+                                     : src[(size_t)posH * p.w + posW];
+                    }
+                }
+            }
+        for (int gi = 0; gi < p.g; ++gi)
+            offsetsOut[gi] = ((size_t)nn * p.f + gi * p.fpg) * P;
+        cpuGemm(p.g, p.fpg, P, K, wptr, offsetsW.data(), K, false, col.data(),
+                offsetsCol.data(), P, false, optr, offsetsOut.data(), P);
+    }
+    activateAll(optr, (size_t)p.n * p.f * P, p.act);
+}
+
+// A 1x1 convolution is a matmul of the weights and the images, so no
+// unfolding is needed
+template <typename T>
+void convPointwise(const ConvParams &p, const T *iptr, const T *wptr,
+                   T *optr) {
+    const int P = p.h * p.w;
+    const int batch = p.n * p.g;
+    vector<size_t> offsetsW(batch), offsetsIn(batch), offsetsOut(batch);
+    for (int nn = 0; nn < p.n; ++nn)
+        for (int gi = 0; gi < p.g; ++gi) {
+            int b = nn * p.g + gi;
+            offsetsW[b] = (size_t)gi * p.fpg * p.cpg;
+            offsetsIn[b] = ((size_t)nn * p.c + gi * p.cpg) * P;
+            offsetsOut[b] = ((size_t)nn * p.f + gi * p.fpg) * P;
+        }
+    cpuGemm(batch, p.fpg, P, p.cpg, wptr, offsetsW.data(), p.cpg, false, iptr,
+            offsetsIn.data(), P, false, optr, offsetsOut.data(), P);
+    activateAll(optr, (size_t)p.n * p.f * P, p.act);
+}
+
+// Each output channel reads one input channel. Bounds are only checked at
+// the borders of the output.
+template <typename T>
+void convDepthwise(const ConvParams &p, const T *iptr, const T *wptr,
+                   T *optr) {
+    // Output columns whose receptive fields are inside the input
+    int owBegin = std::min(p.ow, (p.pw + p.sw - 1) / p.sw);
+    int lastW = p.w - 1 + p.pw - (p.s - 1) * p.dw;
+    int owEnd = lastW < 0 ? 0 : lastW / p.sw + 1;
+    owEnd = std::max(owBegin, std::min(p.ow, owEnd));
+#pragma omp parallel for collapse(2)
+    for (int nn = 0; nn < p.n; ++nn)
+        for (int ff = 0; ff < p.f; ++ff) {
+            const T *src = iptr + ((size_t)nn * p.c + ff) * p.h * p.w;
+            const T *weight = wptr + (size_t)ff * p.r * p.s;
+            T *dst = optr + ((size_t)nn * p.f + ff) * p.oh * p.ow;
+            for (int hh = 0; hh < p.oh; ++hh) {
+                T *row = dst + (size_t)hh * p.ow;
+                auto border = [&](int ww) {
+                    T val = 0;
+                    for (int rr = 0; rr < p.r; ++rr) {
+                        int posH = hh * p.sh + rr * p.dh - p.ph;
+                        if (posH < 0 || posH >= p.h)
+                            continue;
+                        for (int ss = 0; ss < p.s; ++ss) {
+                            int posW = ww * p.sw + ss * p.dw - p.pw;
+                            if (posW >= 0 && posW < p.w)
+                                val += weight[rr * p.s + ss] *
+                                       src[(size_t)posH * p.w + posW];
+                        }
+                    }
+                    row[ww] = val;
+                };
+                for (int ww = 0; ww < owBegin; ++ww)
+                    border(ww);
+                for (int ww = owEnd; ww < p.ow; ++ww)
+                    border(ww);
+                for (int ww = owBegin; ww < owEnd; ++ww)
+                    row[ww] = 0;
+                for (int rr = 0; rr < p.r; ++rr) {
+                    int posH = hh * p.sh + rr * p.dh - p.ph;
+                    if (posH < 0 || posH >= p.h)
+                        continue;
+                    for (int ss = 0; ss < p.s; ++ss) {
+                        const T wv = weight[rr * p.s + ss];
+                        const T *in = src + (size_t)posH * p.w;
+                        const int offset = ss * p.dw - p.pw;
+#pragma omp simd
+                        for (int ww = owBegin; ww < owEnd; ++ww)
+                            row[ww] += wv * in[ww * p.sw + offset];
                     }
+                }
+                for (int ww = 0; ww < p.ow; ++ww)
+                    row[ww] = activate(row[ww], p.act);
             }
         }
+}
+
+// Transforms of Winograd F(mxm, 3x3), from "Fast Algorithms for
+// Convolutional Neural Networks" (Lavin and Gray)
+template <int m> struct WinogradTransform;
+
+template <> struct WinogradTransform<2> {
+    static constexpr int alpha = 4;
+    static constexpr float BT[4][4] = {
+        {1, 0, -1, 0}, {0, 1, 1, 0}, {0, -1, 1, 0}, {0, 1, 0, -1}};
+    static constexpr float G[4][3] = {
+        {1, 0, 0}, {0.5f, 0.5f, 0.5f}, {0.5f, -0.5f, 0.5f}, {0, 0, 1}};
+    static constexpr float AT[2][4] = {{1, 1, 1, 0}, {0, 1, -1, -1}};
+};
+
+template <> struct WinogradTransform<4> {
+    static constexpr int alpha = 6;
+    static constexpr float BT[6][6] = {
+        {4, 0, -5, 0, 1, 0},  {0, -4, -4, 1, 1, 0}, {0, 4, -4, -1, 1, 0},
+        {0, -2, -1, 2, 1, 0}, {0, 2, -1, -2, 1, 0}, {0, 4, 0, -5, 0, 1}};
+    static constexpr float G[6][3] = {
+        {1 / 4.f, 0, 0},
+        {-1 / 6.f, -1 / 6.f, -1 / 6.f},
+        {-1 / 6.f, 1 / 6.f, -1 / 6.f},
+        {1 / 24.f, 1 / 12.f, 1 / 6.f},
+        {1 / 24.f, -1 / 12.f, 1 / 6.f},
+        {0, 0, 1}};
+    static constexpr float AT[4][6] = {{1, 1, 1, 1, 1, 0},
+                                       {0, 1, -1, 2, -2, 0},
+                                       {0, 1, 1, 4, 4, 0},
+                                       {0, 1, -1, 8, -8, 1}};
+};
+
+// Winograd F(mxm, 3x3). Each mxm output tile is computed from an alpha x
+// alpha input tile with alpha^2 instead of 9m^2 multiplications per channel
+// pair, and the multiplications over channels become alpha^2 matmuls done by
+// cpuGemm. F(4x4, 3x3) multiplies less than F(2x2, 3x3), but rounds more.
+template <int m>
+void convWinograd(const ConvParams &p, const float *iptr, const float *wptr,
+                  float *optr) {
+    using Tr = WinogradTransform<m>;
+    constexpr int alpha = Tr::alpha, alpha2 = alpha * alpha;
+    const int C = p.c, F = p.f;
+    const int tilesH = (p.oh + m - 1) / m, tilesW = (p.ow + m - 1) / m;
+    const int P = tilesH * tilesW;
+    // U = G g G^T, stored as [alpha2][F][C]
+    vector<float> U(alpha2 * (size_t)F * C);
+#pragma omp parallel for collapse(2)
+    for (int ff = 0; ff < F; ++ff)
+        for (int cc = 0; cc < C; ++cc) {
+            const float *g = wptr + ((size_t)ff * C + cc) * 9;
+            float t[alpha][3]; // G g
+            for (int i = 0; i < alpha; ++i)
+                for (int j = 0; j < 3; ++j)
+                    t[i][j] = Tr::G[i][0] * g[j] + Tr::G[i][1] * g[3 + j] +
+                              Tr::G[i][2] * g[6 + j];
+            for (int i = 0; i < alpha; ++i)
+                for (int j = 0; j < alpha; ++j)
+                    U[((size_t)(i * alpha + j) * F + ff) * C + cc] =
+                        t[i][0] * Tr::G[j][0] + t[i][1] * Tr::G[j][1] +
+                        t[i][2] * Tr::G[j][2];
+        }
+    vector<float> V(alpha2 * (size_t)C * P), M(alpha2 * (size_t)F * P);
+    vector<size_t> offsetsU(alpha2), offsetsV(alpha2), offsetsM(alpha2);
+    for (int xi = 0; xi < alpha2; ++xi) {
+        offsetsU[xi] = (size_t)xi * F * C;
+        offsetsV[xi] = (size_t)xi * C * P;
+        offsetsM[xi] = (size_t)xi * F * P;
     }
+    for (int nn = 0; nn < p.n; ++nn) {
+        // V = B^T d B, stored as [alpha2][C][P]
+#pragma omp parallel for collapse(2)
+        for (int cc = 0; cc < C; ++cc)
+            for (int tile = 0; tile < P; ++tile) {
+                const float *src = iptr + ((size_t)nn * C + cc) * p.h * p.w;
+                int y0 = tile / tilesW * m - p.ph;
+                int x0 = tile % tilesW * m - p.pw;
+                float d[alpha][alpha];
+                for (int i = 0; i < alpha; ++i)
+                    for (int j = 0; j < alpha; ++j) {
+                        int y = y0 + i, x = x0 + j;
+                        d[i][j] = y < 0 || y >= p.h || x < 0 || x >= p.w
+                                      ? 0.f
+                                      : src[(size_t)y * p.w + x];
+                    }
+                float t[alpha][alpha] = {}; // B^T d
+                for (int i = 0; i < alpha; ++i)
+                    for (int k = 0; k < alpha; ++k)
+                        for (int j = 0; j < alpha; ++j)
+                            t[i][j] += Tr::BT[i][k] * d[k][j];
+                for (int i = 0; i < alpha; ++i)
+                    for (int j = 0; j < alpha; ++j) {
+                        float v = 0;
+                        for (int k = 0; k < alpha; ++k)
+                            v += t[i][k] * Tr::BT[j][k];
+                        V[((size_t)(i * alpha + j) * C + cc) * P + tile] = v;
+                    }
+            }
+        cpuGemm(alpha2, F, P, C, U.data(), offsetsU.data(), C, false,
+                V.data(), offsetsV.data(), P, false, M.data(),
+                offsetsM.data(), P);
+        // Y = A^T M A
+#pragma omp parallel for collapse(2)
+        for (int ff = 0; ff < F; ++ff)
+            for (int tile = 0; tile < P; ++tile) {
+                float t[m][alpha] = {}; // A^T M
+                for (int k = 0; k < alpha; ++k)
+                    for (int j = 0; j < alpha; ++j) {
+                        float mkj =
+                            M[((size_t)(k * alpha + j) * F + ff) * P + tile];
+                        for (int i = 0; i < m; ++i)
+                            t[i][j] += Tr::AT[i][k] * mkj;
+                    }
+                float *dst = optr + ((size_t)nn * F + ff) * p.oh * p.ow;
+                int y0 = tile / tilesW * m, x0 = tile % tilesW * m;
+                for (int i = 0; i < m && y0 + i < p.oh; ++i)
+                    for (int j = 0; j < m && x0 + j < p.ow; ++j) {
+                        float y = 0;
+                        for (int k = 0; k < alpha; ++k)
+                            y += t[i][k] * Tr::AT[j][k];
+                        dst[(size_t)(y0 + i) * p.ow + x0 + j] =
+                            activate(y, p.act);
+                    }
+            }
+    }
+}
 
-    void compute(const Operator &_op,
-                 const RuntimeObj *context) const override {
+// A perf record which also keeps the algorithm tune picked, so that loaded
+// records decide the algorithm without timing again
+struct ConvPerfRecordObj : public PerfRecordObj {
+    ConvAlgo algo = ConvAlgo::Im2col;
+    ConvPerfRecordObj() {}
+    ConvPerfRecordObj(const TimingStats &stats, ConvAlgo algo)
+        : PerfRecordObj(stats), algo(algo) {}
+    void to_json(json &j) override {
+        PerfRecordObj::to_json(j);
+        j["type"] = 3;
+        j["algo"] = enum_to_underlying(algo);
+    }
+    static PerfRecord from_json(const json &j) {
+        ConvPerfRecordObj tmp;
+        static_cast<PerfRecordObj &>(tmp) = *PerfRecordObj::from_json(j);
+        auto algo = j.at("algo").get<int>();
+        IT_ASSERT(algo >= 0 && algo < int(std::size(allConvAlgos)),
+                  "Unknown conv algorithm " + std::to_string(algo));
+        tmp.algo = ConvAlgo(algo);
+        return make_ref<ConvPerfRecordObj>(tmp);
+    }
+};
+} // namespace
+
+/**
+ * @brief Convolution with several algorithms. Each algorithm is an entry of
+ * funcVec, and tune measures the applicable ones and picks the fastest for
+ * each workload.
+ */
+class NaiveConv : public CpuKernelWithoutConfig {
+    template <typename T>
+    void doCompute(ConvAlgo algo, const Ref<ConvObj> &op) const {
+        ConvParams p(op);
+        const T *iptr = op->getInputs(0)->getRawDataPtr<T *>();
+        const T *wptr = op->getInputs(1)->getRawDataPtr<T *>();
+        T *optr = op->getOutput()->getRawDataPtr<T *>();
+        switch (algo) {
+        case ConvAlgo::Direct:
+            return convDirect(p, iptr, wptr, optr);
+        case ConvAlgo::Im2col:
+            return convIm2col(p, iptr, wptr, optr);
+        case ConvAlgo::Pointwise:
+            return convPointwise(p, iptr, wptr, optr);
+        case ConvAlgo::Depthwise:
+            return convDepthwise(p, iptr, wptr, optr);
+        case ConvAlgo::Winograd:
+            if constexpr (std::is_same_v<T, float>)
+                return convWinograd<2>(p, iptr, wptr, optr);
+            break;
+        case ConvAlgo::Winograd4x4:
+            if constexpr (std::is_same_v<T, float>)
+                return convWinograd<4>(p, iptr, wptr, optr);
+            break;
+        }
+        IT_TODO_HALT();
+    }
+
+    void computeWith(ConvAlgo algo, const Operator &_op) const {
+        auto op = as<ConvObj>(_op);
+        IT_ASSERT(isApplicable(algo, ConvParams(op), op->getDType()));
 #define CASE(N)                                                                \
     case N:                                                                    \
-        doCompute<DT<N>::t>(_op, context)
+        doCompute<DT<N>::t>(algo, op)
 
         int dataTypeIdx = _op->getDType().getIndex();
         switch (dataTypeIdx) {
@@ -66,9 +411,66 @@ class NaiveConv : public CpuKernelWithoutConfig {
         default:
             IT_TODO_HALT();
         }
+#undef CASE
+    }
+
+    // The algorithm used before tuning. Winograd rounds differently from
+    // the direct sum, so it is only used once tune has picked it.
+    static ConvAlgo defaultAlgo(const Operator &op) {
+        ConvParams p(as<ConvObj>(op));
+        for (auto algo : {ConvAlgo::Pointwise, ConvAlgo::Depthwise})
+            if (isApplicable(algo, p, op->getDType()))
+                return algo;
+        return ConvAlgo::Im2col;
+    }
+
+  public:
+    NaiveConv() {
+        for (auto algo : allConvAlgos)
+            funcVec.emplace_back([this, algo](const Operator &op,
+                                              const PerfRecord &record,
+                                              const RuntimeObj *context) {
+                this->computeWith(algo, op);
+            });
+    }
+
+    void compute(const Operator &op,
+                 const RuntimeObj *context) const override {
+        computeWith(defaultAlgo(op), op);
+    }
+
+    PerfRecord tune(const Operator &op,
+                    const RuntimeObj *context) const override {
+        ConvParams p(as<ConvObj>(op));
+        TimingStats best;
+        ConvAlgo bestAlgo = defaultAlgo(op);
+        for (auto algo : allConvAlgos) {
+            if (!isApplicable(algo, p, op->getDType()))
+                continue;
+            auto stats = timeitStats([&]() { computeWith(algo, op); });
+            if (best.rounds == 0 || stats.median < best.median)
+                best = stats, bestAlgo = algo;
+        }
+        return make_ref<ConvPerfRecordObj>(best, bestAlgo);
+    }
+
+    void computeFuncTune(const Key perfKey, const Operator &op,
+                         const PerfRecord &record,
+                         const RuntimeObj *context) override {
+        if (computeMap.find(perfKey) != computeMap.end())
+            return;
+        auto convRecord = as<ConvPerfRecordObj>(record);
+        // A record without the algorithm, such as a prediction, or one not
+        // applicable to op, is tuned again
+        if (!convRecord ||
+            !isApplicable(convRecord->algo, ConvParams(as<ConvObj>(op)),
+                          op->getDType()))
+            convRecord = as<ConvPerfRecordObj>(tune(op, context));
+        setComputeFunc(perfKey, funcVec[static_cast<int>(convRecord->algo)]);
     }
 };
 
 REGISTER_KERNEL(Device::CPU, OpType::Conv, NaiveConv, "ConvNaive_CPU");
+REGISTER_CONSTRUCTOR(3, ConvPerfRecordObj::from_json);
 
 } // namespace infini
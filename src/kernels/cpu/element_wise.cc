@@ -1,8 +1,58 @@
 #include "operators/element_wise.h"
+#include "cpu/element_wise.h"
 #include "core/kernel.h"
-#include "utils/operator_utils.h"
 
 namespace infini {
+
+ElementWiseLayout::ElementWiseLayout(const Shape &outDims,
+                                     const vector<Shape> &inputDims)
+    : strides(inputDims.size()) {
+    const int rank = outDims.size();
+    // Strides of every input broadcast to the rank of the output
+    vector<vector<size_t>> full(inputDims.size(), vector<size_t>(rank, 0));
+    for (size_t k = 0; k < inputDims.size(); ++k) {
+        const auto &in = inputDims[k];
+        IT_ASSERT((int)in.size() <= rank);
+        size_t stride = 1;
+        for (int i = in.size() - 1, j = rank - 1; i >= 0; --i, --j) {
+            IT_ASSERT(in[i] == outDims[j] || in[i] == 1);
+            if (in[i] != 1)
+                full[k][j] = stride;
+            stride *= in[i];
+        }
+    }
+    // Drop unit dimensions and merge dimension j into the previous one kept
+    // when every operand is contiguous across the two
+    for (int j = 0; j < rank; ++j) {
+        if (outDims[j] == 1)
+            continue;
+        bool merge = !dims.empty();
+        for (size_t k = 0; merge && k < full.size(); ++k)
+            merge = strides[k].back() == full[k][j] * outDims[j];
+        if (merge) {
+            dims.back() *= outDims[j];
+            for (size_t k = 0; k < full.size(); ++k)
+                strides[k].back() = full[k][j];
+        } else {
+            dims.emplace_back(outDims[j]);
+            for (size_t k = 0; k < full.size(); ++k)
+                strides[k].emplace_back(full[k][j]);
+        }
+    }
+    if (dims.empty()) {
+        dims.emplace_back(1);
+        for (auto &s : strides)
+            s.emplace_back(0);
+    }
+}
+
+size_t ElementWiseLayout::size() const {
+    size_t ret = 1;
+    for (int d : dims)
+        ret *= d;
+    return ret;
+}
+
 class NativeElementWise : public CpuKernelWithoutConfig {
     template <typename T> static T addCompute(T val0, T val1) {
         return val0 + val1;
@@ -43,74 +93,45 @@ class NativeElementWise : public CpuKernelWithoutConfig {
     template <typename T>
     void doCompute(const Operator &_op, const RuntimeObj *context) const {
         auto op = as<ElementWiseObj>(_op);
-        T *inptr0 = op->getInputs(0)->getRawDataPtr<T *>();
-        T *inptr1 = op->getInputs(1)->getRawDataPtr<T *>();
+        const T *inptr0 = op->getInputs(0)->getRawDataPtr<T *>();
+        const T *inptr1 = op->getInputs(1)->getRawDataPtr<T *>();
         T *outptr = op->getOutput()->getRawDataPtr<T *>();
+        ElementWiseLayout layout(
+            op->getOutput()->getDims(),
+            {op->getInputs(0)->getDims(), op->getInputs(1)->getDims()});
+
+#define MAP(F)                                                                 \
+    cpuBinaryMap(layout, inptr0, inptr1, outptr,                               \
+                 [](T val0, T val1) { return F<T>(val0, val1); });             \
+    break
 
-        auto shapeA = op->getInputs(0)->getDims();
-        auto shapeB = op->getInputs(1)->getDims();
-        auto shapeC = op->getOutput()->getDims();
-        auto rank = op->getOutput()->getRank();
-        Shape a(rank, 1);
-        Shape b(rank, 1);
-        std::copy(shapeA.begin(), shapeA.end(),
-                  a.begin() + (rank - shapeA.size()));
-        std::copy(shapeB.begin(), shapeB.end(),
-                  b.begin() + (rank - shapeB.size()));
-        auto getStride = [&](const Shape &shape) {
-            int p = 1;
-            Shape stride(rank);
-            for (auto i = rank; i > 0; --i) {
-                stride[i - 1] = p;
-                p = p * shape[i - 1];
-            }
-            return stride;
-        };
-        Shape strideA = getStride(a);
-        Shape strideB = getStride(b);
-
-        auto n = op->getOutput()->size();
-        T (*_doCompute)(T val0, T val1);
         switch (op->getOpType().underlying()) {
         case OpType::Add:
-            _doCompute = addCompute<T>;
-            break;
+            MAP(addCompute);
         case OpType::Sub:
-            _doCompute = subCompute<T>;
-            break;
+            MAP(subCompute);
         case OpType::Mul:
-            _doCompute = mulCompute<T>;
-            break;
+            MAP(mulCompute);
         case OpType::Div:
-            _doCompute = divCompute<T>;
-            break;
+            MAP(divCompute);
         case OpType::Equal:
-            _doCompute = equalCompute<T>;
-            break;
+            MAP(equalCompute);
         case OpType::GreaterOrEqual:
-            _doCompute = greaterOrEqualCompute<T>;
-            break;
+            MAP(greaterOrEqualCompute);
         case OpType::Greater:
-            _doCompute = greaterCompute<T>;
-            break;
+            MAP(greaterCompute);
         case OpType::LessOrEqual:
-            _doCompute = lessOrEqualCompute<T>;
-            break;
+            MAP(lessOrEqualCompute);
         case OpType::Less:
-            _doCompute = lessCompute<T>;
-            break;
+            MAP(lessCompute);
         default:
             IT_TODO_HALT();
         }
-
-        for (size_t i = 0; i < n; ++i) {
-            auto shapeIndexC = locate_index(i, shapeC);
-            auto indexA = delocate_index(shapeIndexC, a, strideA);
-            auto indexB = delocate_index(shapeIndexC, b, strideB);
-            outptr[i] = _doCompute(inptr0[indexA], inptr1[indexB]);
-        }
+#undef MAP
     }
 
+    bool supportsInPlace() const override { return true; }
+
     void compute(const Operator &_op,
                  const RuntimeObj *context) const override {
 #define CASE(N)                                                                \
@@ -0,0 +1,137 @@
+#include "cpu/gemm.h"
+
+namespace infini {
+
+// The float micro-kernel is compiled for several x86 targets and the best one
+// supported by the CPU is chosen by CPUID when the library is loaded. Other
+// architectures, e.g. aarch64 with NEON, use their baseline vector ISA.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) &&         \
+    defined(__linux__)
+#define GEMM_TARGET_CLONES                                                     \
+    __attribute__((target_clones("arch=skylake-avx512", "arch=haswell",       \
+                                 "default")))
+#else
+#define GEMM_TARGET_CLONES
+#endif
+
+namespace {
+// Register tile of the micro-kernel. The MR x NR accumulators stay in vector
+// registers.
+constexpr int MR = 4, NR = 16;
+// Cache blocking. A packed KC x NC panel of B stays in L2, and the packed
+// MR x KC sliver of A in L1.
+constexpr int MC = 64, NC = 128, KC = 256;
+
+// c[mr x nr] (+)= a[kc x MR]^T * b[kc x NR], with a and b packed
+template <typename T>
+inline void microKernel(int kc, const T *a, const T *b, T *c, int ldc, int mr,
+                        int nr, bool accumulate) {
+    T acc[MR][NR] = {};
+    for (int p = 0; p < kc; ++p)
+        for (int i = 0; i < MR; ++i)
+#pragma omp simd
+            for (int j = 0; j < NR; ++j)
+                acc[i][j] += a[p * MR + i] * b[p * NR + j];
+    for (int i = 0; i < mr; ++i)
+        for (int j = 0; j < nr; ++j)
+            c[i * ldc + j] = accumulate ? c[i * ldc + j] + acc[i][j]
+                                        : acc[i][j];
+}
+
+GEMM_TARGET_CLONES
+void microKernelF32(int kc, const float *a, const float *b, float *c, int ldc,
+                    int mr, int nr, bool accumulate) {
+    microKernel<float>(kc, a, b, c, ldc, mr, nr, accumulate);
+}
+
+// Pack rows [i0, i0 + mc) and columns [p0, p0 + kc) of op(A) into slivers of
+// MR rows, each stored column by column. Missing rows are zero.
+template <typename T>
+void packA(T *dst, const T *A, int lda, bool transA, int i0, int mc, int p0,
+           int kc) {
+    for (int ir = 0; ir < mc; ir += MR)
+        for (int p = 0; p < kc; ++p)
+            for (int ii = 0; ii < MR; ++ii) {
+                size_t i = i0 + ir + ii, k = p0 + p;
+                *dst++ = ir + ii >= mc ? T(0)
+                         : transA      ? A[k * lda + i]
+                                       : A[i * lda + k];
+            }
+}
+
+// Pack rows [p0, p0 + kc) and columns [j0, j0 + nc) of op(B) into slivers of
+// NR columns, each stored row by row. Missing columns are zero.
+template <typename T>
+void packB(T *dst, const T *B, int ldb, bool transB, int p0, int kc, int j0,
+           int nc) {
+    for (int jr = 0; jr < nc; jr += NR)
+        for (int p = 0; p < kc; ++p)
+            for (int jj = 0; jj < NR; ++jj) {
+                size_t j = j0 + jr + jj, k = p0 + p;
+                *dst++ = jr + jj >= nc ? T(0)
+                         : transB      ? B[j * ldb + k]
+                                       : B[k * ldb + j];
+            }
+}
+} // namespace
+
+template <typename T>
+void cpuGemm(int batch, int M, int N, int K, const T *A,
+             const size_t *offsetsA, int lda, bool transA, const T *B,
+             const size_t *offsetsB, int ldb, bool transB, T *C,
+             const size_t *offsetsC, int ldc,
+             const std::function<void(int, int, int, int, int)> &epilogue) {
+    const int mTiles = (M + MC - 1) / MC, nTiles = (N + NC - 1) / NC;
+    const int numTiles = batch * mTiles * nTiles;
+    // Packing buffers are sized to the problem, so that small problems are
+    // cheap to set up
+    const int kcMax = std::max(1, std::min(KC, K));
+    const size_t sizeA = (std::min(MC, M) + MR - 1) / MR * MR * kcMax;
+    const size_t sizeB = (std::min(NC, N) + NR - 1) / NR * NR * kcMax;
+#pragma omp parallel if (numTiles > 1)
+    {
+        vector<T> bufA(sizeA), bufB(sizeB);
+#pragma omp for schedule(static)
+        for (int tile = 0; tile < numTiles; ++tile) {
+            int b = tile / (mTiles * nTiles);
+            int i0 = tile / nTiles % mTiles * MC, j0 = tile % nTiles * NC;
+            int mc = std::min(MC, M - i0), nc = std::min(NC, N - j0);
+            const T *a = A + offsetsA[b], *bb = B + offsetsB[b];
+            T *c = C + offsetsC[b];
+            // The first K block overwrites C. Run one empty block if K is
+            // zero so that C is still cleared.
+            for (int p0 = 0; p0 < K || p0 == 0; p0 += KC) {
+                int kc = std::max(0, std::min(KC, K - p0));
+                packA(bufA.data(), a, lda, transA, i0, mc, p0, kc);
+                packB(bufB.data(), bb, ldb, transB, p0, kc, j0, nc);
+                for (int jr = 0; jr < nc; jr += NR)
+                    for (int ir = 0; ir < mc; ir += MR) {
+                        const T *pa = bufA.data() + ir * kc;
+                        const T *pb = bufB.data() + jr * kc;
+                        T *pc = c + (size_t)(i0 + ir) * ldc + j0 + jr;
+                        int mr = std::min(MR, mc - ir);
+                        int nr = std::min(NR, nc - jr);
+                        if constexpr (std::is_same_v<T, float>)
+                            microKernelF32(kc, pa, pb, pc, ldc, mr, nr,
+                                           p0 > 0);
+                        else
+                            microKernel<T>(kc, pa, pb, pc, ldc, mr, nr,
+                                           p0 > 0);
+                    }
+            }
+            if (epilogue)
+                epilogue(b, i0, j0, mc, nc);
+        }
+    }
+}
+
+#define INSTANTIATE_GEMM(T)                                                    \
+    template void cpuGemm<T>(                                                  \
+        int, int, int, int, const T *, const size_t *, int, bool, const T *,   \
+        const size_t *, int, bool, T *, const size_t *, int,                   \
+        const std::function<void(int, int, int, int, int)> &);
+INSTANTIATE_GEMM(float)
+INSTANTIATE_GEMM(uint32_t)
+#undef INSTANTIATE_GEMM
+
+} // namespace infini
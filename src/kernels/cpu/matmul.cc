@@ -1,27 +1,93 @@
 #include "operators/matmul.h"
 #include "core/kernel.h"
+#include "cpu/gemm.h"
 
 namespace infini {
 
-class NaiveMatmul : public CpuKernelWithoutConfig {
+namespace {
+// Element strides of `dims` broadcast to `rank` dimensions. Broadcast
+// dimensions have zero stride.
+vector<size_t> broadcastStrides(const Shape &dims, int rank) {
+    vector<size_t> ret(rank, 0);
+    size_t stride = 1;
+    for (int i = dims.size() - 1, j = rank - 1; i >= 0; --i, --j) {
+        if (dims[i] != 1)
+            ret[j] = stride;
+        stride *= dims[i];
+    }
+    return ret;
+}
+
+// Offset of each matrix in the batch, for batch dimensions `batchDims` of the
+// output and element strides `strides` of the input
+vector<size_t> batchOffsets(const Shape &batchDims,
+                            const vector<size_t> &strides) {
+    size_t batch = 1;
+    for (int d : batchDims)
+        batch *= d;
+    vector<size_t> ret(batch, 0);
+    for (size_t b = 0; b < batch; ++b) {
+        size_t rest = b;
+        for (int d = batchDims.size() - 1; d >= 0; --d) {
+            ret[b] += rest % batchDims[d] * strides[d];
+            rest /= batchDims[d];
+        }
+    }
+    return ret;
+}
+} // namespace
+
+/**
+ * @brief Runs cpuGemm over the batch, and applies the bias and the activation
+ * to each tile of the output once it is done.
+ */
+class BlockedMatmul : public CpuKernelWithoutConfig {
     template <typename T>
     void doCompute(const Operator &_op, const RuntimeObj *context) const {
         auto op = as<MatmulObj>(_op);
-        IT_ASSERT(op->getInputs().size() == 2, "Bias is not supported yet.");
-        T *A = op->getInputs(0)->getRawDataPtr<T *>();
-        T *B = op->getInputs(1)->getRawDataPtr<T *>();
+        const T *A = op->getInputs(0)->getRawDataPtr<T *>();
+        const T *B = op->getInputs(1)->getRawDataPtr<T *>();
         T *C = op->getOutput()->getRawDataPtr<T *>();
-        IT_ASSERT(op->getTransA() == false && op->getTransB() == false);
-        IT_ASSERT(op->getAct() == ActType::None);
+        const bool transA = op->getTransA(), transB = op->getTransB();
+        const ActType act = op->getAct();
         const int M = op->getM(), N = op->getN(), K = op->getK();
-        for (int i = 0; i < M; i++) {
-            for (int j = 0; j < N; j++) {
-                C[i * N + j] = 0;
-                for (int k = 0; k < K; k++) {
-                    C[i * N + j] += A[i * K + k] * B[k * N + j];
-                }
-            }
+
+        auto outDims = op->getOutput()->getDims();
+        int rank = outDims.size();
+        Shape batchDims(outDims.begin(), outDims.end() - 2);
+        auto offsetsA = batchOffsets(
+            batchDims, broadcastStrides(op->getInputs(0)->getDims(), rank));
+        auto offsetsB = batchOffsets(
+            batchDims, broadcastStrides(op->getInputs(1)->getDims(), rank));
+        const int batch = offsetsA.size();
+        const T *bias = nullptr;
+        vector<size_t> offsetsBias, biasStrides;
+        if (auto biasTensor = op->getBias()) {
+            bias = biasTensor->getRawDataPtr<T *>();
+            biasStrides = broadcastStrides(biasTensor->getDims(), rank);
+            offsetsBias = batchOffsets(batchDims, biasStrides);
         }
+
+        vector<size_t> offsetsC(batch);
+        for (int b = 0; b < batch; ++b)
+            offsetsC[b] = (size_t)b * M * N;
+        std::function<void(int, int, int, int, int)> epilogue;
+        if (bias || act != ActType::None)
+            epilogue = [&](int b, int i0, int j0, int mc, int nc) {
+                T *c = C + offsetsC[b];
+                for (int i = i0; i < i0 + mc; ++i)
+                    for (int j = j0; j < j0 + nc; ++j) {
+                        T &v = c[(size_t)i * N + j];
+                        if (bias)
+                            v += bias[offsetsBias[b] +
+                                      i * biasStrides[rank - 2] +
+                                      j * biasStrides[rank - 1]];
+                        v = activate(v, act);
+                    }
+            };
+        cpuGemm(batch, M, N, K, A, offsetsA.data(), transA ? M : K, transA, B,
+                offsetsB.data(), transB ? K : N, transB, C, offsetsC.data(), N,
+                epilogue);
     }
 
     void compute(const Operator &_op,
@@ -42,6 +108,7 @@ class NaiveMatmul : public CpuKernelWithoutConfig {
     }
 };
 
-REGISTER_KERNEL(Device::CPU, OpType::MatMul, NaiveMatmul, "MatmulNaive_CPU");
+REGISTER_KERNEL(Device::CPU, OpType::MatMul, BlockedMatmul,
+                "MatmulBlocked_CPU");
 
 } // namespace infini
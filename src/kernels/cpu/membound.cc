@@ -2,71 +2,42 @@
 
 #include "operators/membound.h"
 #include "core/kernel.h"
-#include "nnet/Visitor/Interpreter.h"
-#include <cstring>
+#include "nnet/loop_nest.h"
 
 namespace infini {
 
-class MemboundInterpreter : public Kernel {
+class MemboundLoopNest : public Kernel {
+    template <typename T>
+    static void run(const Ref<MemBoundObj> &op, const nnet::LoopNest &nest) {
+        // Read and write the blobs in place
+        vector<const T *> inputs;
+        for (const auto &input : op->getInputs())
+            inputs.emplace_back(input->getRawDataPtr<T *>());
+        nest.run(inputs, op->getOutput()->getRawDataPtr<T *>());
+    }
+
     void compute(const Operator &_op, const PerfRecord &record,
                  const RuntimeObj *_context) const override {
         auto op = as<MemBoundObj>(_op);
         auto output = op->getOutput();
         output->dataMalloc();
-        // TODO: use uint32_t in Interpreter
-        std::unordered_map<std::string,
-                           nnet::Ref<std::vector<nnet::Interpreter::ttype>>>
-            rangeInputs;
-        // TODO: avoid this copy by modifying Interpreter
-        for (int i = 0; i < op->numInputs(); i++) {
-            auto input = op->getInputs(i);
-            auto data = nnet::make_ref<std::vector<nnet::Interpreter::ttype>>(
-                input->getBytes() / sizeof(nnet::Interpreter::ttype));
-            memcpy(data->data(), op->getInputs(i)->getRawDataPtr<void *>(),
-                   input->getBytes());
-            rangeInputs.insert({op->getNnetInputs()[i]->getName(), data});
-        }
-        // for (size_t i = 0; i < op->getInputs().size(); ++i) {
-        //     rangeInputs.insert({op->getNnetInputs()[i]->getName(),
-        //                         op->getInputs(i)->getDataBlob()});
-        // }
-
         nnet::RangeOp range = nnet::as<nnet::RangeOpNode>(op->getNnetExpr());
-        // const auto &rangeShape = range->getOutputShape();
-        // const auto &outputShape = output->getDims();
         // rangeShape and outputShape may extra dims of length 1.
         // But their sizes should be the same.
         IT_ASSERT((ssize_t)range->getOutputSize() == (ssize_t)output->size());
-        // const ssize_t iEnd = range->getOutputSize();
-        // #pragma omp parallel for default(none)  shared(range, output,
-        // rangeShape, outputShape, rangeInputs, iEnd)
-        //         for (ssize_t i = 0; i < iEnd; i++) {
-        //             std::vector<int> rangePos(range->getNumOutputDims(), 0);
-        //             std::vector<int> outputPos(outputShape.size(), 0);
-        //             ssize_t t = i;
-        //             for (int j = range->getNumOutputDims() - 1; 0 <= j; j--)
-        //             {
-        //                 int extent = rangeShape[j];
-        //                 rangePos[j] = t % extent;
-        //                 t /= extent;
-        //             }
-        //             t = i;
-        //             for (int j = outputShape.size() - 1; 0 <= j; j--) {
-        //                 int extent = outputShape[j];
-        //                 outputPos[j] = t % extent;
-        //                 t /= extent;
-        //             }
-        //             auto vals =
-        //                 nnet::Interpreter(rangeInputs).interpret(range,
-        //                 {rangePos});
-        //             output->setData(outputPos, vals[0]);
-        //         }
-        auto vals = nnet::Interpreter(rangeInputs).interpretAllOutput(range);
-        // output->setData(outputPos, vals[0]);
-        vector<uint32_t> valsUint(vals.size());
-        for (size_t i = 0; i < vals.size(); ++i)
-            valsUint[i] = (uint32_t)vals[i];
-        output->copyin(valsUint);
+        const auto dtype = output->getDType();
+        for (const auto &input : op->getInputs())
+            IT_ASSERT(input->getDType() == dtype);
+
+        nnet::LoopNest nest(range, op->getNnetInputs());
+        if (dtype == DataType::Float32)
+            run<float>(op, nest);
+        else if (dtype == DataType::Int32)
+            run<int32_t>(op, nest);
+        else if (dtype == DataType::UInt32)
+            run<uint32_t>(op, nest);
+        else
+            IT_TODO_HALT_MSG("MemBound on CPU for " + dtype.toString());
     }
 
     void compute(const Operator &op, const RuntimeObj *context) const override {
@@ -80,8 +51,8 @@ class MemboundInterpreter : public Kernel {
     }
 };
 
-REGISTER_KERNEL(Device::CPU, OpType::MemBound, MemboundInterpreter,
-                "MemboundInterpreter_CPU");
+REGISTER_KERNEL(Device::CPU, OpType::MemBound, MemboundLoopNest,
+                "MemboundLoopNest_CPU");
 
 } // namespace infini
 
@@ -10,6 +10,10 @@ class NaiveIdentity : public CpuKernelWithoutConfig {
         auto size = _op->getInputs()[0]->getBytes();
         void *inptr = _op->getInputs(0)->getRawDataPtr<void *>();
         void *outptr = _op->getOutput()->getRawDataPtr<void *>();
+        // the output usually shares the input's data, see
+        // GraphObj::planMemory
+        if (outptr == inptr)
+            return;
 
         std::memcpy(outptr, inptr, size);
     }
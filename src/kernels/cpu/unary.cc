@@ -1,7 +1,9 @@
 #include "operators/unary.h"
 #include "core/constants.h"
 #include "core/kernel.h"
+#include "cpu/element_wise.h"
 #include "operators/softmax.h"
+#include <limits>
 
 namespace infini {
 class NativeUnary : public CpuKernelWithoutConfig {
@@ -77,86 +79,65 @@ class NativeUnary : public CpuKernelWithoutConfig {
         T *inptr = op->getInputs(0)->getRawDataPtr<T *>();
         T *outptr = op->getOutput()->getRawDataPtr<T *>();
 
-        auto outDim = op->getOutput()->getDims();
         auto n = op->getOutput()->size();
 
-        T (*_doCompute)(T val);
+#define MAP(F)                                                                 \
+    cpuUnaryMap(inptr, outptr, n, [](T val) { return F<T>(val); });            \
+    break
+
         switch (op->getOpType().underlying()) {
         case OpType::Relu:
-            _doCompute = reluCompute<T>;
-            break;
+            MAP(reluCompute);
         case OpType::Gelu:
-            _doCompute = geluCompute<T>;
-            break;
+            MAP(geluCompute);
         case OpType::Silu:
-            _doCompute = siluCompute<T>;
-            break;
+            MAP(siluCompute);
         case OpType::Sigmoid:
-            _doCompute = sigmoidCompute<T>;
-            break;
+            MAP(sigmoidCompute);
         case OpType::HardSigmoid:
-            _doCompute = hardSigmoidCompute<T>;
-            break;
+            MAP(hardSigmoidCompute);
         case OpType::HardSwish:
-            _doCompute = hardSwishCompute<T>;
-            break;
+            MAP(hardSwishCompute);
         case OpType::Tanh:
-            _doCompute = tanhCompute<T>;
-            break;
+            MAP(tanhCompute);
         case OpType::Abs:
-            _doCompute = absCompute<T>;
-            break;
+            MAP(absCompute);
         case OpType::Sqrt:
-            _doCompute = sqrtCompute<T>;
-            break;
+            MAP(sqrtCompute);
         case OpType::Erf:
-            _doCompute = erfCompute<T>;
-            break;
+            MAP(erfCompute);
         case OpType::Neg:
-            _doCompute = negCompute<T>;
-            break;
+            MAP(negCompute);
         case OpType::Cos:
-            _doCompute = cosCompute<T>;
-            break;
+            MAP(cosCompute);
         case OpType::Sin:
-            _doCompute = sinCompute<T>;
-            break;
+            MAP(sinCompute);
         case OpType::Tan:
-            _doCompute = tanCompute<T>;
-            break;
+            MAP(tanCompute);
         case OpType::Sinh:
-            _doCompute = sinhCompute<T>;
-            break;
+            MAP(sinhCompute);
         case OpType::Cosh:
-            _doCompute = coshCompute<T>;
-            break;
+            MAP(coshCompute);
         case OpType::Acos:
-            _doCompute = aCosCompute<T>;
-            break;
+            MAP(aCosCompute);
         case OpType::Asin:
-            _doCompute = aSinCompute<T>;
-            break;
+            MAP(aSinCompute);
         case OpType::Asinh:
-            _doCompute = aSinhCompute<T>;
-            break;
+            MAP(aSinhCompute);
         case OpType::Atan:
-            _doCompute = aTanCompute<T>;
-            break;
+            MAP(aTanCompute);
         case OpType::Atanh:
-            _doCompute = aTanhCompute<T>;
-            break;
+            MAP(aTanhCompute);
         case OpType::Acosh:
-            _doCompute = aCoshCompute<T>;
-            break;
+            MAP(aCoshCompute);
         default:
             IT_TODO_HALT();
         }
-
-        for (size_t offset = 0; offset < n; offset++) {
-            outptr[offset] = _doCompute(inptr[offset]);
-        }
+#undef MAP
     }
 
+    bool supportsInPlace() const override { return true; }
+
     void compute(const Operator &_op,
                  const RuntimeObj *context) const override {
 #define CASE(N)                                                                \
@@ -219,16 +200,18 @@ class Clip : public CpuKernelWithoutConfig {
         T *outptr = op->getOutput()->getRawDataPtr<T *>();
         auto minValue = op->getMin();
         auto maxValue = op->getMax();
+        const T lo =
+            minValue ? T(*minValue) : std::numeric_limits<T>::lowest();
+        const T hi = maxValue ? T(*maxValue) : std::numeric_limits<T>::max();
 
         auto n = op->getOutput()->size();
-        for (size_t offset = 0; offset < n; offset++) {
-            auto val = *inptr++;
-            *outptr++ = (minValue && val < *minValue)   ? *minValue
-                        : (maxValue && val > *maxValue) ? *maxValue
-                                                        : val;
-        }
+        cpuUnaryMap(inptr, outptr, n, [lo, hi](T val) {
+            return val < lo ? lo : val > hi ? hi : val;
+        });
     }
 
+    bool supportsInPlace() const override { return true; }
+
     void compute(const Operator &_op,
                  const RuntimeObj *context) const override {
 #define CASE(N)                                                                \
@@ -256,29 +239,27 @@ class Log : public CpuKernelWithoutConfig {
         auto logType = op->getType(); // get log type
 
         auto len = op->getOutput()->size();
-        for (size_t offset = 0; offset < len; offset++) {
-            T res;
-            auto val = *inptr++;
-            switch (logType) {
-            case LogObj::LogE:
-                res = std::log(val);
-                *outptr++ = res;
-                break;
-            case LogObj::Log2:
-                res = std::log2(val);
-                *outptr++ = res;
-                break;
-            case LogObj::Log10:
-                res = std::log10(val);
-                *outptr++ = res;
-                break;
-            default:
-                printf("LogType not Defined");
-                break;
-            }
+        switch (logType) {
+        case LogObj::LogE:
+            cpuUnaryMap(inptr, outptr, len,
+                        [](T val) -> T { return std::log(val); });
+            break;
+        case LogObj::Log2:
+            cpuUnaryMap(inptr, outptr, len,
+                        [](T val) -> T { return std::log2(val); });
+            break;
+        case LogObj::Log10:
+            cpuUnaryMap(inptr, outptr, len,
+                        [](T val) -> T { return std::log10(val); });
+            break;
+        default:
+            printf("LogType not Defined");
+            break;
         }
     }
 
+    bool supportsInPlace() const override { return true; }
+
     void compute(const Operator &_op,
                  const RuntimeObj *context) const override {
 #define CASE(N)                                                                \
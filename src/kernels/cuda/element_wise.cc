@@ -121,6 +121,8 @@ class MaxCudnn : public ElementWiseCudnn {
 };
 
 class ElementWiseCuda : public CudaKernelWithoutConfig {
+    bool supportsInPlace() const override { return true; }
+
     void compute(const Operator &_op,
                  const RuntimeObj *_context) const override {
         auto op = as<ElementWiseObj>(_op);
@@ -6,6 +6,8 @@ class CopyCuda : public CudaKernelWithoutConfig {
                  const RuntimeObj *_context) const override {
         auto inData = op->getInputs(0)->getRawDataPtr<void *>();
         auto outData = op->getOutputs()[0]->getRawDataPtr<void *>();
+        if (outData == inData)
+            return;
         cudaMemcpyAsync(outData, inData, op->getInputs(0)->getBytes(),
                         cudaMemcpyDeviceToDevice,
                         CUDAStream::getCurrentStream());
@@ -11,6 +11,8 @@ class UnaryCuda : public CudaKernelWithoutConfig {
                  const RuntimeObj *_context) const override {
         unary_kernel(_op);
     }
+
+    bool supportsInPlace() const override { return true; }
 };
 
 class EluCuda : public CudaKernelWithoutConfig {
@@ -70,6 +72,8 @@ class CastCuda : public CudaKernelWithoutConfig {
 class ActivationCudnn : public CudaKernelWithoutConfig {
     virtual cudnnActivationMode_t getOpType() const = 0;
     virtual tuple<float, float> getAlphBeta() const { return {1.f, 0.f}; }
+    // cudnnActivationForward allows x and y to be the same buffer
+    bool supportsInPlace() const override { return true; }
     void compute(const Operator &_op,
                  const RuntimeObj *_context) const override {
         auto op = as<UnaryObj>(_op);
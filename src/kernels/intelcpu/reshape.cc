@@ -8,6 +8,9 @@ class MklReshape : public MklKernelWithoutConfig {
                  const RuntimeObj *_context) const override {
         IT_ASSERT(op->getDType() == DataType::Float32);
         auto context = dynamic_cast<const MklRuntimeObj *>(_context);
+        if (op->getInputs(0)->getRawDataPtr<void *>() ==
+            op->getOutput(0)->getRawDataPtr<void *>())
+            return;
 
         std::vector<dnnl_dim_t> dims;
         for (size_t i = 0; i < op->getInputs(0)->getRank(); ++i)
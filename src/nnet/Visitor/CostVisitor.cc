@@ -0,0 +1,90 @@
+#include "nnet/Visitor/CostVisitor.h"
+#include "nnet/routine.h"
+
+namespace nnet {
+
+void CostVisitor::visit_(const Tensor &c) {
+    if (inUnmatched && read.emplace(c->getName()).second)
+        unmatchedElements += c->getSize();
+    const auto &routine = c->getSource();
+    if (!routine || !computed.emplace(c->getName()).second)
+        return;
+    cost += routineTime(c);
+    const bool wasUnmatched = inUnmatched;
+    inUnmatched = false;
+    for (const auto &input : routine->getInputs())
+        dispatch(input);
+    inUnmatched = wasUnmatched;
+}
+
+double CostVisitor::estimate(const Expr &root) {
+    cost = 0;
+    computed.clear();
+    read.clear();
+    unmatchedElements = 0;
+    auto range = as<RangeOpNode>(root);
+    inUnmatched = range != nullptr;
+    dispatch(root);
+    if (range) {
+        unmatchedElements += range->getOutputSize();
+        cost += std::max(memoryTime(unmatchedElements),
+                         getReductionFlops(range) / kernelFlops * 1000);
+    }
+    return cost;
+}
+
+double CostVisitor::memoryTime(int64_t nElements) {
+    return double(nElements) * 4 / bandwidth * 1000;
+}
+
+double CostVisitor::routineTime(const Tensor &output) {
+    const auto &routine = output->getSource();
+    int64_t nElements = output->getSize();
+    for (const auto &input : routine->getInputs())
+        nElements += input->getSize();
+    double flops = 0, peak = kernelFlops;
+    switch (routine->getType()) {
+    case RoutineType::MatmulNodeType: {
+        const auto [b, m, n, k, transA, transB] =
+            as<MatmulNode>(routine)->getArgs();
+        flops = 2. * b * m * n * k;
+        break;
+    }
+    case RoutineType::ConvNodeType: {
+        // multiply-adds of an output element: the weight size over F
+        const auto &weight = routine->getInputs()[1];
+        flops = 2. * output->getSize() * weight->getSize() /
+                weight->getShape(0);
+        break;
+    }
+    case RoutineType::G2bmmNodeType: {
+        const auto [b, m, w, k, dilation] = as<G2bmmNode>(routine)->getArgs();
+        flops = 2. * b * m * (2 * w + 1) * k;
+        break;
+    }
+    case RoutineType::GbmmNodeType: {
+        const auto [b, m, w, n, dilation] = as<GbmmNode>(routine)->getArgs();
+        flops = 2. * b * m * (2 * w + 1) * n;
+        break;
+    }
+    case RoutineType::ElementWiseNodeType:
+        if (auto range = as<RangeOpNode>(routine->getExpr()))
+            flops = getReductionFlops(range);
+        peak = elementWiseFlops;
+        break;
+    default:
+        nnet_unimplemented_continue();
+    }
+    return std::max(memoryTime(nElements), flops / peak * 1000);
+}
+
+double CostVisitor::getReductionFlops(const RangeOp &range) {
+    if (range->getSumVarRanges().empty())
+        return 0;
+    double flops = 2. * range->getOutputSize();
+    for (const auto &[var, sumRange] : range->getSumVarRanges())
+        flops *= sumRange.second - sumRange.first;
+    return flops;
+}
+
+} // namespace nnet
@@ -0,0 +1,85 @@
+#include "nnet/derivation_cache.h"
+#include "nlohmann/json.hpp"
+#include "nnet/Visitor/Serializer.h"
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+namespace nnet {
+
+namespace fs = std::filesystem;
+
+DerivationCache::DerivationCache(const string &dir) : dir(dir) {}
+
+string DerivationCache::getEntryPath(const string &key) const {
+    // FNV-1a, stable across processes unlike std::hash
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+    return (fs::path(dir) / name).string();
+}
+
+std::optional<VecExpr> DerivationCache::load(const string &key) const {
+    const fs::path entry = getEntryPath(key);
+    std::ifstream fin(entry / "index.json");
+    if (!fin)
+        return std::nullopt;
+    try {
+        nlohmann::json index;
+        fin >> index;
+        if (index["Version"] != VERSION || index["Key"] != key)
+            return std::nullopt;
+        VecExpr candidates;
+        for (int i = 0, n = index["Candidates"]; i < n; ++i) {
+            const auto path = entry / (std::to_string(i) + ".json");
+            if (!fs::exists(path))
+                return std::nullopt;
+            candidates.emplace_back(Serializer().deserialize(path.string()));
+            if (!candidates.back())
+                return std::nullopt;
+        }
+        return candidates;
+    } catch (const std::exception &) {
+        // Unreadable or malformed entries, and filesystem errors
+        return std::nullopt;
+    }
+}
+
+void DerivationCache::store(const string &key,
+                            const VecExpr &candidates) const {
+    const fs::path entry = getEntryPath(key);
+    fs::path tmp = entry;
+    tmp += ".tmp" + std::to_string(getpid());
+    std::error_code ec;
+    // A cache that cannot be written is skipped rather than failing the
+    // derivation
+    try {
+        if (fs::exists(entry))
+            return;
+        fs::create_directories(tmp);
+        for (size_t i = 0; i < candidates.size(); ++i)
+            Serializer().serialize(
+                candidates[i], (tmp / (std::to_string(i) + ".json")).string());
+        // The index is written last, an entry without it is a miss
+        std::ofstream fout(tmp / "index.json");
+        fout << nlohmann::json{{"Version", VERSION},
+                               {"Key", key},
+                               {"Candidates", candidates.size()}};
+        fout.close();
+        if (!fout)
+            throw std::runtime_error("Failed to write " + tmp.string());
+        // Fails if another process stored the entry meanwhile, then keep
+        // theirs
+        fs::rename(tmp, entry, ec);
+        if (!ec)
+            return;
+    } catch (const std::exception &) {
+    }
+    fs::remove_all(tmp, ec);
+}
+
+} // namespace nnet
@@ -15,11 +15,13 @@
 #include "nnet/Visitor/CheckOOBVisitor.h"
 #include "nnet/Visitor/CloneMutator.h"
 #include "nnet/Visitor/CompareMultiFormulasVisitor.h"
+#include "nnet/Visitor/CostVisitor.h"
 #include "nnet/Visitor/CountRoutineVisitor.h"
 #include "nnet/Visitor/FullPrinterVisitor.h"
 #include "nnet/Visitor/HashVisitor.h"
 #include "nnet/Visitor/MergeMemboundMutator.h"
 #include "nnet/Visitor/Serializer.h"
+#include <algorithm>
 
 namespace nnet {
 
@@ -262,14 +264,25 @@ void Derivator::nextStep(Formula &origin, int depth, Expr &rCur, Expr newCur) {
     HashType formulaHash = HashVisitor().getHash(origin.root);
     if (enableHashPruning) {
         if (searchState != 2) {
-            if (visited.find(formulaHash) != visited.end()) {
+            if (!searchRoot->visited.insert(
+                    getVisitedKey(formulaHash, depth))) {
                 rCur.swap(newCur);
                 return;
             }
-            visited.emplace(formulaHash);
         }
     }
 
+    // Rule 4 derives merged stages at depth - 1, so depth can be negative
+    if (spawnDepth > 0 && depth < spawnDepth)
+        spawn(origin, depth);
+    else if (bestFirstSlack > 0)
+        defer(origin, depth);
+    else
+        deriveNext(origin, depth);
+    rCur.swap(newCur);
+}
+
+void Derivator::deriveNext(Formula &origin, int depth) {
     if (searchState > 0) {
         guidedSearch(origin, depth);
     } else {
@@ -282,7 +295,139 @@ void Derivator::nextStep(Formula &origin, int depth, Expr &rCur, Expr newCur) {
         else
             ruleBasedDerivate(origin, depth + 1);
     }
-    rCur.swap(newCur);
+}
+
+HashType Derivator::getVisitedKey(HashType formulaHash, int depth) const {
+    // Everything deciding how a state is derived, so that pruning a state
+    // loses nothing whichever path, or task, visits it first
+    HashType key = genhash(formulaHash, depth);
+    key = genhash(key, searchState);
+    key = genhash(key, routineTypeToId(targetOp));
+    key = genhash(key, cntAppliedRules[1]);
+    return genhash(key, cntAppliedRules[3]);
+}
+
+void Derivator::setParallelSearch(int _spawnDepth) {
+    spawnDepth = _spawnDepth;
+}
+
+void Derivator::runSearch(const std::function<void()> &search) {
+    nnet_assert(spawnDepth == 0 || bestFirstSlack == 0,
+                "Best-first search is serial");
+    if (bestFirstSlack > 0) {
+        search();
+        deriveFrontier();
+        return;
+    }
+    if (spawnDepth == 0) {
+        search();
+        return;
+    }
+    // Tasks spawned in the single region all finish at its implicit barrier
+#pragma omp parallel
+#pragma omp single
+    search();
+    mergeForks();
+}
+
+std::unique_ptr<Derivator> Derivator::fork() const {
+    auto ret = std::make_unique<Derivator>(maxDepth, enableHashPruning,
+                                           logMode, passMode);
+    ret->rulesOverall = rulesOverall;
+    ret->searchStrategy = searchStrategy;
+    ret->enableEquivalenceCheck = enableEquivalenceCheck;
+    ret->logFnPrefix = logFnPrefix;
+    ret->targetOp = targetOp;
+    ret->substituteRules = substituteRules;
+    ret->cntAppliedRules = cntAppliedRules;
+    ret->intermediateStates = intermediateStates;
+    ret->ruleStates = ruleStates;
+    ret->ruleMsgs = ruleMsgs;
+    ret->searchState = searchState;
+    ret->spawnDepth = spawnDepth;
+    ret->searchRoot = searchRoot;
+    return ret;
+}
+
+void Derivator::spawn(const Formula &origin, int depth) {
+    Derivator *task = fork().release();
+    forks.emplace_back(candidates.size(), task);
+    // The rules of this derivator go on mutating origin in place
+    Expr root = CloneMutator().clone(origin.root);
+    int bfsDepth = origin.bfsDepth;
+#pragma omp task firstprivate(task, root, bfsDepth, depth)
+    {
+        Formula formula(root, bfsDepth);
+        task->deriveNext(formula, depth);
+    }
+}
+
+void Derivator::mergeForks() {
+    auto it = candidates.begin();
+    size_t pos = 0;
+    for (auto &[position, fork] : forks) {
+        fork->mergeForks();
+        for (; pos < position; ++pos)
+            ++it;
+        candidates.splice(it, fork->candidates);
+        cntStates += fork->cntStates;
+        searchedMaxDepth = max(searchedMaxDepth, fork->searchedMaxDepth);
+    }
+    forks.clear();
+}
+
+void Derivator::setBestFirstSearch(double slack) {
+    nnet_assert(slack == 0 || slack >= 1, "Slack is less than 1");
+    bestFirstSlack = slack;
+}
+
+bool Derivator::isDerivedLater(const PendingState &lhs,
+                               const PendingState &rhs) {
+    if (lhs.bound != rhs.bound)
+        return lhs.bound > rhs.bound;
+    if (lhs.depth != rhs.depth)
+        return lhs.depth < rhs.depth;
+    return lhs.order > rhs.order;
+}
+
+void Derivator::defer(Formula &origin, int depth) {
+    const double bound = CostVisitor().estimate(origin.root);
+    if (bound > bestCost * bestFirstSlack) {
+        ++cntPrunedStates;
+        return;
+    }
+    // The rules go on mutating origin in place
+    frontier.push_back({bound, depth, nPendingStates++,
+                        CloneMutator().clone(origin.root), origin.bfsDepth,
+                        searchState, targetOp, cntAppliedRules,
+                        intermediateStates, ruleStates, ruleMsgs});
+    std::push_heap(frontier.begin(), frontier.end(), isDerivedLater);
+}
+
+void Derivator::deriveFrontier() {
+    auto saved = std::tuple(searchState, targetOp, cntAppliedRules,
+                            intermediateStates, ruleStates, ruleMsgs);
+    while (!frontier.empty()) {
+        std::pop_heap(frontier.begin(), frontier.end(), isDerivedLater);
+        PendingState state = std::move(frontier.back());
+        frontier.pop_back();
+        if (state.bound > bestCost * bestFirstSlack) {
+            // The remaining states are bounded by no less
+            cntPrunedStates += 1 + frontier.size();
+            frontier.clear();
+            break;
+        }
+        searchState = state.searchState;
+        targetOp = state.targetOp;
+        cntAppliedRules = std::move(state.cntAppliedRules);
+        intermediateStates = std::move(state.intermediateStates);
+        ruleStates = std::move(state.ruleStates);
+        ruleMsgs = std::move(state.ruleMsgs);
+        Formula formula(state.root, state.bfsDepth);
+        deriveNext(formula, state.depth);
+    }
+    std::tie(searchState, targetOp, cntAppliedRules, intermediateStates,
+             ruleStates, ruleMsgs) = std::move(saved);
 }
 
 void Derivator::ruleBasedDFS(Formula &origin, int depth, vector<int> _rules,
@@ -294,13 +439,13 @@ void Derivator::ruleBasedDFS(Formula &origin, int depth, vector<int> _rules,
     for (auto i : _rules)
         rulesOverall.push_back({i});
     substituteRules = _substituteRules;
-    ruleBasedDerivate(origin, depth);
+    runSearch([&] { ruleBasedDerivate(origin, depth); });
 }
 
 void Derivator::search(Formula &origin, int depth) {
     SaveStateGuard guard(*this, origin.root, string("Init: ") + __FUNCTION__);
     searchStrategy = Strategy::DFS;
-    dfs(origin, depth);
+    runSearch([&] { dfs(origin, depth); });
 }
 
 void Derivator::print() {
@@ -407,6 +552,8 @@ void Derivator::appendCanddiate(const Tensor &tensor, int depth) {
     //     return;
 
     candidates.emplace_back(tensor, depth);
+    if (bestFirstSlack > 0)
+        bestCost = min(bestCost, CostVisitor().estimate(tensor));
     // dbg("!!!!!!!!!!!!!!!Success!!!!!!!!!!!!!!!");
     if (enableEquivalenceCheck)
         checkDerivationEquivalence();
@@ -428,11 +575,12 @@ bool Derivator::checkOOB(const RangeOp &rangeOp, bool halt) {
 }
 
 string Derivator::newTensorName() {
-    return "T" + std::to_string(++nTensorNames);
+    return "T" + std::to_string(++searchRoot->nTensorNames);
 }
 
 Var Derivator::getNewVar() {
-    return make_ref<VarNode>("i" + std::to_string(++nIteratorNames));
+    return make_ref<VarNode>("i" +
+                             std::to_string(++searchRoot->nIteratorNames));
 }
 
 void Derivator::pushIntermediateState(const Expr &expr) {
@@ -476,8 +624,10 @@ void Derivator::printStatistics() {
     printf("#Candidates = %lu\n", candidates.size());
     printf("#Intermediate states = %d\n", cntStates);
     printf("#Hashed intermediate states = %lu\n", visited.size());
-    printf("#Iteratos = %d\n", nIteratorNames);
-    printf("#Tensors = %d\n", nTensorNames);
+    if (bestFirstSlack > 0)
+        printf("#Pruned states by cost = %d\n", cntPrunedStates);
+    printf("#Iteratos = %d\n", nIteratorNames.load());
+    printf("#Tensors = %d\n", nTensorNames.load());
 }
 
 void Derivator::setDumpFirstSuccess(const string &_logFnPrefix) {
@@ -522,6 +672,21 @@ void Derivator::checkDerivationEquivalence() {
     }
 }
 
+bool VisitedSet::insert(HashType hash) {
+    auto &shard = shards[static_cast<unsigned>(hash) % nShards];
+    std::lock_guard lock(shard.mutex);
+    return shard.hashes.emplace(hash).second;
+}
+
+size_t VisitedSet::size() const {
+    size_t ret = 0;
+    for (auto &shard : shards) {
+        std::lock_guard lock(shard.mutex);
+        ret += shard.hashes.size();
+    }
+    return ret;
+}
+
 void Derivator::setEquivalenceCheck() { enableEquivalenceCheck = true; }
 
 Derivator::PassMode Derivator::getPassMode() { return passMode; }
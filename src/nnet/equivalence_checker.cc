@@ -0,0 +1,104 @@
+#include "nnet/equivalence_checker.h"
+#include "nnet/Visitor/GetTensorsVisitor.h"
+#include "nnet/loop_nest.h"
+#include <algorithm>
+#include <atomic>
+#include <random>
+
+namespace nnet {
+
+EquivalenceChecker::EquivalenceChecker(int64_t nSamples, uint64_t seed)
+    : nSamples(nSamples), seed(seed) {
+    nnet_assert(nSamples > 0, "No samples");
+}
+
+vector<int64_t> EquivalenceChecker::sampleBlocks(int64_t outputSize) const {
+    const int64_t nBlocks = (outputSize + blockSize - 1) / blockSize;
+    vector<int64_t> begins;
+    if (nBlocks * blockSize <= nSamples) {
+        for (int64_t i = 0; i < nBlocks; ++i)
+            begins.emplace_back(i * blockSize);
+        return begins;
+    }
+    // Blocks are aligned, so that they do not overlap
+    std::mt19937_64 gen(seed);
+    std::uniform_int_distribution<int64_t> dist(
+        1, std::max<int64_t>(1, nBlocks - 2));
+    begins = {0, (nBlocks - 1) * blockSize};
+    for (int64_t i = 2; i * blockSize < nSamples; ++i)
+        begins.emplace_back(dist(gen) * blockSize);
+    std::sort(begins.begin(), begins.end());
+    begins.erase(std::unique(begins.begin(), begins.end()), begins.end());
+    return begins;
+}
+
+bool EquivalenceChecker::check(const VecExpr &exprs) const {
+    if (exprs.size() < 2)
+        return true;
+    const auto range0 = as<RangeOpNode>(exprs[0]);
+    nnet_assert(range0, "The reference is not a RangeOp");
+    const auto tensors0 = GetTensorsVisitor().get(range0);
+    // Inputs in the order of names, so that the data is reproducible
+    vector<string> names;
+    for (const auto &[name, tensor] : tensors0)
+        names.emplace_back(name);
+    std::sort(names.begin(), names.end());
+    vector<Tensor> tensors;
+    vector<vector<int32_t>> data;
+    vector<const int32_t *> inputs;
+    std::mt19937 gen(seed);
+    // Small values keep sums of products far from overflow
+    std::uniform_int_distribution<int32_t> dist(-8, 8);
+    for (const auto &name : names) {
+        tensors.emplace_back(tensors0.at(name));
+        auto &values = data.emplace_back(tensors.back()->getSize());
+        for (auto &value : values)
+            value = dist(gen);
+        inputs.emplace_back(values.data());
+    }
+
+    const int64_t outputSize = range0->getOutputSize();
+    const auto begins = sampleBlocks(outputSize);
+    vector<int32_t> expected(begins.size() * blockSize);
+    // Evaluate the sampled blocks of range, into expected for the reference
+    auto evaluate = [&](const RangeOp &range, bool isReference) {
+        const LoopNest nest(range, tensors);
+        std::atomic<bool> equal = true;
+#pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < begins.size(); ++i) {
+            if (!equal.load(std::memory_order_relaxed))
+                continue;
+            const int64_t begin = begins[i],
+                          end = std::min(begin + blockSize, outputSize);
+            int32_t *ans = expected.data() + i * blockSize;
+            if (isReference) {
+                nest.run(inputs, begin, end, ans);
+                continue;
+            }
+            vector<int32_t> values(end - begin);
+            nest.run(inputs, begin, end, values.data());
+            if (!std::equal(values.begin(), values.end(), ans))
+                equal = false;
+        }
+        return equal.load();
+    };
+    evaluate(range0, true);
+
+    for (size_t i = 1; i < exprs.size(); ++i) {
+        const auto range = as<RangeOpNode>(exprs[i]);
+        if (!range)
+            continue;
+        const auto tensors1 = GetTensorsVisitor().get(range);
+        if (tensors1.size() != tensors0.size() ||
+            !std::all_of(names.begin(), names.end(), [&](const string &name) {
+                return tensors1.count(name);
+            }))
+            continue;
+        if (range->getOutputShape() != range0->getOutputShape() ||
+            !evaluate(range, false))
+            return false;
+    }
+    return true;
+}
+
+} // namespace nnet
@@ -287,9 +287,8 @@ Expr MatmulPattern::buildExpr(
 
 const Pattern &MatmulPattern::getMatmulPattern() {
     static class MatmulPattern exprIT;
-    static bool inited = false;
-    if (!inited) {
-        inited = true;
+    // initialized once even if patterns are matched by concurrent tasks
+    [[maybe_unused]] static const bool inited = [] {
         int M = 224, N = 8, K = 16;
         auto m = make_ref<VarNode>("_Matmul_m");
         auto n = make_ref<VarNode>("_Matmul_n");
@@ -303,15 +302,14 @@ const Pattern &MatmulPattern::getMatmulPattern() {
         auto success = exprIT.analyzeExpr(range);
         assert(success);
         exprIT.buildTable({0, 1});
-    }
+        return true;
+    }();
     return exprIT;
 }
 
 const Pattern &ConvPattern::getPattern() {
     static class ConvPattern exprIT;
-    static bool inited = false;
-    if (!inited) {
-        inited = true;
+    [[maybe_unused]] static const bool inited = [] {
         // The shape is meaningless but cannot be zero IT building
         int N = 8, C = 16, H = 224, W = 224, F = 16, R = 3, S = 3;
         // auto n = make_ref<VarNode>("_Matmul_n");
@@ -325,7 +323,8 @@ const Pattern &ConvPattern::getPattern() {
         auto success = exprIT.analyzeExpr(range);
         assert(success);
         exprIT.buildTable({0, 1});
-    }
+        return true;
+    }();
     return exprIT;
 }
 
@@ -396,9 +395,7 @@ DEF_SG2BMM_VAR(k);
 
 const Pattern &Sg2bmmPattern::getPattern() {
     static class Sg2bmmPattern exprIT;
-    static bool inited = false;
-    if (!inited) {
-        inited = true;
+    [[maybe_unused]] static const bool inited = [] {
         // The shape is meaningless but cannot be zero IT building
         int Batch = 8, M = 32, K = 224, W = 2;
         // auto n = make_ref<VarNode>("_Matmul_n");
@@ -412,7 +409,8 @@ const Pattern &Sg2bmmPattern::getPattern() {
         auto success = exprIT.analyzeExpr(range);
         assert(success);
         exprIT.buildTableWithDefaultMap();
-    }
+        return true;
+    }();
     return exprIT;
 }
 
@@ -450,9 +448,7 @@ DEF_LongformerGBMM_VAR(n);
 
 const Pattern &LongformerGBMMPattern::getPattern() {
     static class LongformerGBMMPattern exprIT;
-    static bool inited = false;
-    if (!inited) {
-        inited = true;
+    [[maybe_unused]] static const bool inited = [] {
         // The shape is meaningless but cannot be zero IT building
         int Batch = 8, M = 32, N = 224, W = 2;
         auto A =
@@ -466,7 +462,8 @@ const Pattern &LongformerGBMMPattern::getPattern() {
         auto success = exprIT.analyzeExpr(range);
         assert(success);
         exprIT.buildTableWithDefaultMap();
-    }
+        return true;
+    }();
     return exprIT;
 }
 
@@ -0,0 +1,574 @@
+#include "nnet/loop_nest.h"
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+namespace nnet {
+
+LoopNest::LoopNest(const RangeOp &range, const vector<Tensor> &inputs)
+    : outputSize(range->getOutputSize()) {
+    for (const auto &input : inputs)
+        inputNames.emplace_back(input->getName());
+    addStage(range, -1, {});
+    scope.clear();
+}
+
+int LoopNest::addSlot(const Var &var, const Range &range) {
+    const int slot = slotRanges.size();
+    slotRanges.emplace_back(range);
+    scope.emplace_back(var->getName(), slot);
+    return slot;
+}
+
+int LoopNest::findSlot(const string &name) const {
+    for (auto it = scope.rbegin(); it != scope.rend(); ++it)
+        if (it->first == name)
+            return it->second;
+    nnet_assert(0, "Iterator " + name + " is not in scope");
+    return -1;
+}
+
+int LoopNest::addStage(const RangeOp &range, int parent,
+                       const vector<IndexRef> &bindings) {
+    const int s = stages.size();
+    const size_t scopeSize = scope.size();
+    Stage stage;
+    stage.parent = parent;
+    stage.bindings = bindings;
+    for (const auto &[var, varRange] : range->getLoopVarRanges()) {
+        const int slot = addSlot(var, varRange);
+        if (parent < 0) {
+            stage.loopSlots.emplace_back(slot);
+            stage.loopRanges.emplace_back(varRange);
+        } else {
+            stage.boundSlots.emplace_back(slot);
+            stage.boundRanges.emplace_back(varRange);
+        }
+    }
+    stage.nOutputLoops = stage.loopSlots.size();
+    for (const auto &[var, varRange] : range->getSumVarRanges()) {
+        stage.loopSlots.emplace_back(addSlot(var, varRange));
+        stage.loopRanges.emplace_back(varRange);
+        if (varRange.first >= varRange.second)
+            stage.empty = true;
+    }
+    stages.emplace_back(std::move(stage));
+    compileValue(s, range->getSummand(), 0);
+
+    // Increments of the affines per loop step, for strength reduction
+    auto &st = stages[s];
+    const size_t nAffines = st.affines.size();
+    st.steps.assign(st.loopSlots.size() * nAffines, 0);
+    st.wraps.assign(st.loopSlots.size() * nAffines, 0);
+    for (size_t l = 0; l < st.loopSlots.size(); ++l) {
+        const int64_t extent = st.loopRanges[l].second - st.loopRanges[l].first;
+        for (size_t a = 0; a < nAffines; ++a)
+            for (const auto &[slot, coefficient] : st.affines[a].terms)
+                if (slot == st.loopSlots[l]) {
+                    st.steps[l * nAffines + a] = coefficient;
+                    st.wraps[l * nAffines + a] = coefficient * (extent - 1);
+                }
+    }
+    scope.resize(scopeSize);
+    return s;
+}
+
+void LoopNest::compileValue(int s, const Expr &expr, int depth) {
+    maxStackSize = std::max(maxStackSize, depth + 1);
+    switch (expr->getType()) {
+    case NodeType::ConstantNodeType:
+        stages[s].program.push_back(
+            {InstType::Const, as<ConstantNode>(expr)->getValue()});
+        break;
+    case NodeType::VarNodeType:
+        stages[s].program.push_back(
+            {InstType::Iter, findSlot(as<VarNode>(expr)->getName())});
+        break;
+    case NodeType::SubscriptNodeType: {
+        const auto subscript = as<SubscriptNode>(expr);
+        const auto &object = subscript->getObject();
+        if (object->getType() == NodeType::TensorNodeType) {
+            compileAccess(s, subscript);
+        } else {
+            const auto range = as<RangeOpNode>(object);
+            nnet_assert(range, "Subscripted object is not a RangeOp");
+            nnet_assert(subscript->getDims() == range->getNumOutputDims(),
+                        "Subscript rank mismatch");
+            vector<IndexRef> bindings;
+            for (const auto &index : subscript->getIndex())
+                bindings.emplace_back(compileIndex(s, index));
+            const int child = addStage(range, s, bindings);
+            stages[s].program.push_back({InstType::Stage, child});
+        }
+        break;
+    }
+    case NodeType::BinaryOpNodeType: {
+        const auto binary = as<BinaryOpNode>(expr);
+        compileValue(s, binary->getLhs(), depth);
+        compileValue(s, binary->getRhs(), depth + 1);
+        InstType type;
+        switch (binary->getOpType()) {
+        case OpType::Add:
+            type = InstType::Add;
+            break;
+        case OpType::Sub:
+            type = InstType::Sub;
+            break;
+        case OpType::Mul:
+            type = InstType::Mul;
+            break;
+        case OpType::Div:
+            type = InstType::Div;
+            break;
+        case OpType::Mod:
+            type = InstType::Mod;
+            break;
+        default:
+            nnet_unimplemented_halt();
+            return;
+        }
+        stages[s].program.push_back({type});
+        break;
+    }
+    case NodeType::FuncNodeType: {
+        const auto func = as<FuncNode>(expr);
+        compileValue(s, func->getObject(), depth);
+        switch (func->getFuncType()) {
+        case FuncType::Relu:
+            stages[s].program.push_back({InstType::Relu});
+            break;
+        case FuncType::Tanh:
+            stages[s].program.push_back({InstType::Tanh});
+            break;
+        case FuncType::PRelu:
+            stages[s].program.push_back({InstType::PRelu});
+            break;
+        default:
+            nnet_unimplemented_halt();
+        }
+        break;
+    }
+    default:
+        nnet_unimplemented_halt();
+    }
+}
+
+void LoopNest::compileAccess(int s, const Subscript &subscript) {
+    const auto tensor = as<TensorNode>(subscript->getObject());
+    const auto it =
+        std::find(inputNames.begin(), inputNames.end(), tensor->getName());
+    nnet_assert(it != inputNames.end(),
+                "Tensor " + tensor->getName() + " is not an input");
+    const auto &shape = tensor->getShape();
+    const auto &index = subscript->getIndex();
+    nnet_assert(index.size() == shape.size(), "Subscript rank mismatch");
+
+    Access access;
+    access.input = it - inputNames.begin();
+    vector<int64_t> strides(shape.size(), 1);
+    for (int d = int(shape.size()) - 2; d >= 0; --d)
+        strides[d] = strides[d + 1] * shape[d + 1];
+    vector<std::optional<Affine>> affines;
+    for (const auto &e : index)
+        affines.emplace_back(toAffine(e));
+    const bool allAffine = std::all_of(affines.begin(), affines.end(),
+                                       [](const auto &a) { return a; });
+    if (allAffine) {
+        Affine offset;
+        for (size_t d = 0; d < shape.size(); ++d) {
+            addTerms(offset, *affines[d], strides[d]);
+            // Only check the dims that interval analysis cannot prove
+            const auto [lo, hi] = getInterval(*affines[d]);
+            if (lo < 0 || hi >= shape[d])
+                access.checks.emplace_back(
+                    IndexRef{true, addAffine(s, *affines[d])}, shape[d]);
+        }
+        access.offset = {true, addAffine(s, offset)};
+    } else {
+        for (const auto &e : index)
+            access.dims.emplace_back(compileIndex(s, e));
+        access.strides = strides;
+        access.shape = shape;
+    }
+    stages[s].accesses.emplace_back(std::move(access));
+    stages[s].program.push_back(
+        {InstType::Load, int(stages[s].accesses.size()) - 1});
+}
+
+LoopNest::IndexRef LoopNest::compileIndex(int s, const Expr &expr) {
+    if (auto affine = toAffine(expr))
+        return {true, addAffine(s, std::move(*affine))};
+    vector<Inst> program;
+    maxIndexStackSize =
+        std::max(maxIndexStackSize, compileGeneric(expr, program, 0));
+    stages[s].generics.emplace_back(std::move(program));
+    return {false, int(stages[s].generics.size()) - 1};
+}
+
+int LoopNest::addAffine(int s, Affine affine) {
+    stages[s].affines.emplace_back(std::move(affine));
+    return stages[s].affines.size() - 1;
+}
+
+void LoopNest::addTerms(Affine &lhs, const Affine &rhs, int64_t scale) {
+    lhs.constant += rhs.constant * scale;
+    for (const auto &[slot, coefficient] : rhs.terms) {
+        auto it = std::find_if(lhs.terms.begin(), lhs.terms.end(),
+                               [&](const auto &t) { return t.first == slot; });
+        if (it == lhs.terms.end())
+            lhs.terms.emplace_back(slot, coefficient * scale);
+        else
+            it->second += coefficient * scale;
+    }
+}
+
+std::optional<LoopNest::Affine> LoopNest::toAffine(const Expr &expr) const {
+    switch (expr->getType()) {
+    case NodeType::ConstantNodeType:
+        return Affine{as<ConstantNode>(expr)->getValue(), {}};
+    case NodeType::VarNodeType:
+        return Affine{0, {{findSlot(as<VarNode>(expr)->getName()), 1}}};
+    case NodeType::BinaryOpNodeType: {
+        const auto binary = as<BinaryOpNode>(expr);
+        auto lhs = toAffine(binary->getLhs());
+        auto rhs = toAffine(binary->getRhs());
+        if (!lhs || !rhs)
+            return std::nullopt;
+        Affine ret;
+        switch (binary->getOpType()) {
+        case OpType::Add:
+            addTerms(*lhs, *rhs, 1);
+            return lhs;
+        case OpType::Sub:
+            addTerms(*lhs, *rhs, -1);
+            return lhs;
+        case OpType::Mul:
+            if (rhs->terms.empty())
+                addTerms(ret, *lhs, rhs->constant);
+            else if (lhs->terms.empty())
+                addTerms(ret, *rhs, lhs->constant);
+            else
+                return std::nullopt;
+            return ret;
+        case OpType::Div:
+        case OpType::Mod:
+            if (!lhs->terms.empty() || !rhs->terms.empty() ||
+                rhs->constant <= 0)
+                return std::nullopt;
+            ret.constant = binary->getOpType() == OpType::Div
+                               ? lhs->constant / rhs->constant
+                               : lhs->constant % rhs->constant;
+            return ret;
+        default:
+            return std::nullopt;
+        }
+    }
+    default:
+        return std::nullopt;
+    }
+}
+
+int LoopNest::compileGeneric(const Expr &expr, vector<Inst> &program,
+                             int depth) const {
+    switch (expr->getType()) {
+    case NodeType::ConstantNodeType:
+        program.push_back(
+            {InstType::Const, as<ConstantNode>(expr)->getValue()});
+        return depth + 1;
+    case NodeType::VarNodeType:
+        program.push_back(
+            {InstType::Iter, findSlot(as<VarNode>(expr)->getName())});
+        return depth + 1;
+    case NodeType::BinaryOpNodeType: {
+        const auto binary = as<BinaryOpNode>(expr);
+        const int lhsSize = compileGeneric(binary->getLhs(), program, depth);
+        const int size = std::max(
+            lhsSize, compileGeneric(binary->getRhs(), program, depth + 1));
+        switch (binary->getOpType()) {
+        case OpType::Add:
+            program.push_back({InstType::Add});
+            break;
+        case OpType::Sub:
+            program.push_back({InstType::Sub});
+            break;
+        case OpType::Mul:
+            program.push_back({InstType::Mul});
+            break;
+        case OpType::Div:
+            program.push_back({InstType::Div});
+            break;
+        case OpType::Mod:
+            program.push_back({InstType::Mod});
+            break;
+        default:
+            nnet_unimplemented_halt();
+        }
+        return size;
+    }
+    default:
+        nnet_unimplemented_halt();
+        return 0;
+    }
+}
+
+pair<int64_t, int64_t> LoopNest::getInterval(const Affine &affine) const {
+    int64_t lo = affine.constant, hi = affine.constant;
+    for (const auto &[slot, coefficient] : affine.terms) {
+        const auto &[begin, end] = slotRanges[slot];
+        const int64_t last = std::max(begin, end - 1);
+        if (coefficient >= 0) {
+            lo += coefficient * begin;
+            hi += coefficient * last;
+        } else {
+            lo += coefficient * last;
+            hi += coefficient * begin;
+        }
+    }
+    return {lo, hi};
+}
+
+template <typename T> class LoopNest::Evaluator {
+    const LoopNest &nest;
+    const vector<const T *> &inputs;
+    vector<int64_t> slots;
+    // current values of the affines of each stage
+    vector<vector<int64_t>> values;
+    // a region of maxStackSize per stage
+    vector<T> stack;
+    vector<int64_t> indexStack;
+
+  public:
+    Evaluator(const LoopNest &nest, const vector<const T *> &inputs)
+        : nest(nest), inputs(inputs), slots(nest.slotRanges.size()),
+          stack(nest.stages.size() * nest.maxStackSize),
+          indexStack(nest.maxIndexStackSize) {
+        for (const auto &stage : nest.stages)
+            values.emplace_back(stage.affines.size());
+    }
+
+    // Evaluate the outputs [begin, end) of the root stage into output[0,
+    // end - begin)
+    void run(int64_t begin, int64_t end, T *output) {
+        const auto &root = nest.stages[0];
+        if (root.empty) {
+            std::fill(output, output + (end - begin), T(0));
+            return;
+        }
+        int64_t t = begin;
+        for (int l = root.nOutputLoops - 1; l >= 0; --l) {
+            const auto &[lo, hi] = root.loopRanges[l];
+            slots[root.loopSlots[l]] = lo + t % (hi - lo);
+            t /= hi - lo;
+        }
+        for (size_t l = root.nOutputLoops; l < root.loopSlots.size(); ++l)
+            slots[root.loopSlots[l]] = root.loopRanges[l].first;
+        initAffines(0);
+        for (int64_t i = begin; i < end; ++i) {
+            T acc = 0;
+            do
+                acc += evalSummand(0);
+            while (advance(0) >= root.nOutputLoops);
+            output[i - begin] = acc;
+        }
+    }
+
+  private:
+    void initAffines(int s) {
+        const auto &affines = nest.stages[s].affines;
+        for (size_t a = 0; a < affines.size(); ++a) {
+            int64_t value = affines[a].constant;
+            for (const auto &[slot, coefficient] : affines[a].terms)
+                value += coefficient * slots[slot];
+            values[s][a] = value;
+        }
+    }
+
+    // Step the loops of a stage like an odometer. Returns the loop that was
+    // incremented, or -1 after the last iteration.
+    int advance(int s) {
+        const auto &stage = nest.stages[s];
+        auto &cur = values[s];
+        const size_t nAffines = cur.size();
+        for (int l = int(stage.loopSlots.size()) - 1; l >= 0; --l) {
+            auto &slot = slots[stage.loopSlots[l]];
+            if (++slot < stage.loopRanges[l].second) {
+                const int64_t *step = stage.steps.data() + l * nAffines;
+                for (size_t a = 0; a < nAffines; ++a)
+                    cur[a] += step[a];
+                return l;
+            }
+            slot = stage.loopRanges[l].first;
+            const int64_t *wrap = stage.wraps.data() + l * nAffines;
+            for (size_t a = 0; a < nAffines; ++a)
+                cur[a] -= wrap[a];
+        }
+        return -1;
+    }
+
+    int64_t evalIndex(int s, const IndexRef &ref) {
+        if (ref.affine)
+            return values[s][ref.id];
+        int64_t *sp = indexStack.data();
+        for (const auto &inst : nest.stages[s].generics[ref.id]) {
+            switch (inst.type) {
+            case InstType::Const:
+                *sp++ = inst.arg;
+                break;
+            case InstType::Iter:
+                *sp++ = slots[inst.arg];
+                break;
+            case InstType::Add:
+                --sp, sp[-1] += sp[0];
+                break;
+            case InstType::Sub:
+                --sp, sp[-1] -= sp[0];
+                break;
+            case InstType::Mul:
+                --sp, sp[-1] *= sp[0];
+                break;
+            case InstType::Div:
+                --sp, sp[-1] /= sp[0];
+                break;
+            case InstType::Mod:
+                --sp, sp[-1] %= sp[0];
+                break;
+            default:
+                nnet_unimplemented_halt();
+            }
+        }
+        return indexStack[0];
+    }
+
+    T load(int s, const Access &access) {
+        for (const auto &[ref, bound] : access.checks) {
+            const int64_t i = values[s][ref.id];
+            if (i < 0 || i >= bound)
+                return 0;
+        }
+        if (access.dims.empty())
+            return inputs[access.input][values[s][access.offset.id]];
+        int64_t offset = 0;
+        for (size_t d = 0; d < access.dims.size(); ++d) {
+            const int64_t i = evalIndex(s, access.dims[d]);
+            if (i < 0 || i >= access.shape[d])
+                return 0;
+            offset += i * access.strides[d];
+        }
+        return inputs[access.input][offset];
+    }
+
+    T evalStage(int s) {
+        const auto &stage = nest.stages[s];
+        for (size_t i = 0; i < stage.bindings.size(); ++i) {
+            const int64_t value = evalIndex(stage.parent, stage.bindings[i]);
+            if (value < stage.boundRanges[i].first ||
+                value >= stage.boundRanges[i].second)
+                return 0;
+            slots[stage.boundSlots[i]] = value;
+        }
+        if (stage.empty)
+            return 0;
+        for (size_t l = 0; l < stage.loopSlots.size(); ++l)
+            slots[stage.loopSlots[l]] = stage.loopRanges[l].first;
+        initAffines(s);
+        T acc = 0;
+        do
+            acc += evalSummand(s);
+        while (advance(s) >= 0);
+        return acc;
+    }
+
+    T evalSummand(int s) {
+        const auto &stage = nest.stages[s];
+        T *const base = stack.data() + s * nest.maxStackSize;
+        T *sp = base;
+        for (const auto &inst : stage.program) {
+            switch (inst.type) {
+            case InstType::Const:
+                *sp++ = T(inst.arg);
+                break;
+            case InstType::Iter:
+                *sp++ = T(slots[inst.arg]);
+                break;
+            case InstType::Load:
+                *sp++ = load(s, stage.accesses[inst.arg]);
+                break;
+            case InstType::Stage:
+                *sp++ = evalStage(inst.arg);
+                break;
+            case InstType::Add:
+                --sp, sp[-1] += sp[0];
+                break;
+            case InstType::Sub:
+                --sp, sp[-1] -= sp[0];
+                break;
+            case InstType::Mul:
+                --sp, sp[-1] *= sp[0];
+                break;
+            case InstType::Div:
+                --sp, sp[-1] /= sp[0];
+                break;
+            case InstType::Mod:
+                --sp;
+                if constexpr (std::is_floating_point_v<T>)
+                    sp[-1] = std::fmod(sp[-1], sp[0]);
+                else
+                    sp[-1] %= sp[0];
+                break;
+            case InstType::Relu:
+                sp[-1] = std::max(sp[-1], T(0));
+                break;
+            case InstType::Tanh:
+                sp[-1] = T(std::tanh(double(sp[-1])));
+                break;
+            case InstType::PRelu:
+                if (sp[-1] < T(0))
+                    sp[-1] = T(double(sp[-1]) * 0.25);
+                break;
+            default:
+                nnet_unimplemented_halt();
+            }
+        }
+        return base[0];
+    }
+};
+
+template <typename T>
+void LoopNest::run(const vector<const T *> &inputs, T *output) const {
+    nnet_assert(inputs.size() == inputNames.size(), "Wrong number of inputs");
+    // Consecutive outputs share the decoding of the first position and the
+    // incremental index updates, so threads take chunks of them
+    const int64_t chunk = 1024, nChunks = (outputSize + chunk - 1) / chunk;
+#pragma omp parallel if (nChunks > 1)
+    {
+        Evaluator<T> evaluator(*this, inputs);
+#pragma omp for schedule(dynamic)
+        for (int64_t i = 0; i < nChunks; ++i)
+            evaluator.run(i * chunk, std::min(outputSize, (i + 1) * chunk),
+                          output + i * chunk);
+    }
+}
+
+template <typename T>
+void LoopNest::run(const vector<const T *> &inputs, int64_t begin, int64_t end,
+                   T *output) const {
+    nnet_assert(inputs.size() == inputNames.size(), "Wrong number of inputs");
+    nnet_assert(0 <= begin && begin <= end && end <= outputSize,
+                "Outputs out of range");
+    Evaluator<T>(*this, inputs).run(begin, end, output);
+}
+
+template void LoopNest::run<float>(const vector<const float *> &,
+                                   float *) const;
+template void LoopNest::run<int32_t>(const vector<const int32_t *> &,
+                                     int32_t *) const;
+template void LoopNest::run<uint32_t>(const vector<const uint32_t *> &,
+                                      uint32_t *) const;
+template void LoopNest::run<float>(const vector<const float *> &, int64_t,
+                                   int64_t, float *) const;
+template void LoopNest::run<int32_t>(const vector<const int32_t *> &, int64_t,
+                                     int64_t, int32_t *) const;
+template void LoopNest::run<uint32_t>(const vector<const uint32_t *> &,
+                                      int64_t, int64_t, uint32_t *) const;
+
+} // namespace nnet
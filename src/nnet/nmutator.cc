@@ -3,6 +3,7 @@
 #include "nnet/Visitor/FullPrinterVisitor.h"
 #include "nnet/Visitor/GetTensorsVisitor.h"
 #include "nnet/Visitor/MatchReshapeVisitor.h"
+#include "nnet/derivation_cache.h"
 #include "nnet/derivator.h"
 #include "operators/conv.h"
 #include "operators/matmul.h"
@@ -24,6 +25,26 @@ NMutator::~NMutator() {}
 
 void NMutator::setToNaiveMembound() { mode = Mode::ToNaiveMembound; }
 
+void NMutator::setDerivationCache(const std::string &dir) {
+    derivationCache = std::make_unique<nnet::DerivationCache>(dir);
+}
+
+std::string NMutator::getDerivationKey(const Operator &op) const {
+    // The expression of op is built from its workload and input shapes
+    std::string key = std::string(op->getOpType().toString()) + ":" +
+                      vecToString(op->getOpPerfKey().attrs);
+    for (const auto &input : op->getInputs())
+        key += ";" + vecToString(input->getDims());
+    key += ";maxDepth=" + std::to_string(maxDepth);
+    if (bestFirstSlack > 0)
+        key += ";bestFirst=" + std::to_string(bestFirstSlack);
+    if (mode == Mode::RuleBased)
+        key += ";rules=" + vecToString(derivationRules);
+    else
+        key += ";search";
+    return key;
+}
+
 vector<Graph> NMutator::run(const Graph &in_graph) {
     vector<Graph> out_graphs{in_graph};
     // Test helper: naively transform one Op to Membound
@@ -105,24 +126,41 @@ void NMutator::runSingleOp(Graph in_graph, std::vector<Graph> &out_graphs) {
     if (!expr)
         return;
 
-    nnet::Derivator derivator(maxDepth);
-    nnet::Formula conv_9x9(expr, 0);
-    // const std::vector<int> rules{3, 2, 2, 2, 2, 5, 8, 8, 6, 91, 90};
-    // ConvTraspose
-    // const std::vector<int> rules{1, 7, 7, 2, 8, 6, 6}; // G2BMM
-    if (mode == Mode::Normal) {
-        derivator.search(conv_9x9, 0);
-    } else if (mode == Mode::RuleBased) {
-        dbg(derivationRules);
-        derivator.ruleBasedDFS(conv_9x9, 0, derivationRules);
-    } else
-        IT_TODO_HALT_MSG("Unknown NMutator search mode.");
-    const auto &candidates = derivator.getCandidates();
+    std::string cacheKey;
+    std::optional<nnet::VecExpr> cached;
+    if (derivationCache) {
+        cacheKey = getDerivationKey(computeOps[0]);
+        cached = derivationCache->load(cacheKey);
+    }
+    nnet::VecExpr candidates;
+    if (cached) {
+        candidates = std::move(*cached);
+        ++cntCacheHits;
+    } else {
+        nnet::Derivator derivator(maxDepth);
+        derivator.setBestFirstSearch(bestFirstSlack);
+        nnet::Formula conv_9x9(expr, 0);
+        // const std::vector<int> rules{3, 2, 2, 2, 2, 5, 8, 8, 6, 91, 90};
+        // ConvTraspose
+        // const std::vector<int> rules{1, 7, 7, 2, 8, 6, 6}; // G2BMM
+        if (mode == Mode::Normal) {
+            derivator.search(conv_9x9, 0);
+        } else if (mode == Mode::RuleBased) {
+            dbg(derivationRules);
+            derivator.ruleBasedDFS(conv_9x9, 0, derivationRules);
+        } else
+            IT_TODO_HALT_MSG("Unknown NMutator search mode.");
+        for (const auto &candidate : derivator.getCandidates())
+            candidates.emplace_back(candidate.root);
+        cntStates += derivator.getNumIntermediateStates();
+        if (derivationCache)
+            derivationCache->store(cacheKey, candidates);
+    }
     dbg(candidates.size());
     // derivator.print();
     for (const auto &candidate : candidates) {
-        // dbg(nnet::FullPrinterVisitor().print(candidate.root));
-        if (auto g = expressionToGraph(candidate.root, in_graph)) {
+        // dbg(nnet::FullPrinterVisitor().print(candidate));
+        if (auto g = expressionToGraph(candidate, in_graph)) {
             out_graphs.emplace_back(g);
         }
         // break; // HACK:Debug only for the first subgraph
@@ -131,8 +169,7 @@ void NMutator::runSingleOp(Graph in_graph, std::vector<Graph> &out_graphs) {
     // for (auto graph : out_graphs) {
     //     graph->print();
     // }
-    cntStates += derivator.getNumIntermediateStates();
-    cntCandidates += derivator.getNumCandidates();
+    cntCandidates += candidates.size();
 }
 
 void NMutator::runMultipleOps(Graph in_graph, std::vector<Graph> &out_graphs) {
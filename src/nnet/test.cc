@@ -3,6 +3,7 @@
 #include "nnet/Visitor/HashVisitor.h"
 #include "nnet/Visitor/Interpreter.h"
 #include "nnet/Visitor/Serializer.h"
+#include "nnet/equivalence_checker.h"
 #include <filesystem>
 namespace nnet {
 
@@ -62,30 +63,7 @@ bool checkExprLogSame(string pathRelativeToProjectHome, int start, int end) {
 }
 
 bool checkExprsEquvivalence(VecExpr exprs) {
-    if (exprs.size() < 2)
-        return true;
-    auto inputsMap0 = GetTensorsVisitor().get(exprs[0]);
-    RangeOp range0 = as<RangeOpNode>(exprs[0]);
-    Interpreter interpreter(range0);
-    auto ans0 = interpreter.interpretUniformSample(range0);
-    for (size_t i = 1; i + 1 < exprs.size(); ++i) {
-        RangeOp range1 = as<RangeOpNode>(exprs[i]);
-        auto inputsMap1 = GetTensorsVisitor().get(range1);
-        // if expr0 and expr1 have different inputs, skip and return true
-        if (inputsMap0.size() != inputsMap1.size())
-            return true;
-        for (const auto &[name, tensor] : inputsMap0) {
-            if (!inputsMap1.count(name))
-                return true;
-        }
-        auto ans1 = interpreter.interpretUniformSample(range1);
-        if (ans0.size() != ans1.size())
-            return false;
-        for (size_t i = 0; i < ans0.size(); ++i)
-            if (ans0[i] != ans1[i])
-                return false;
-    }
-    return true;
+    return EquivalenceChecker().check(exprs);
 }
 
 } // namespace nnet
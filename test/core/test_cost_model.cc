@@ -0,0 +1,64 @@
+#include "core/cost_model.h"
+#include "core/dummy_mutator.h"
+#include "core/graph.h"
+#include "core/runtime.h"
+#include "core/search_engine.h"
+#include "operators/element_wise.h"
+#include "operators/matmul.h"
+#include "test.h"
+
+namespace infini {
+
+TEST(CostModel, heuristic) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto a = g->addTensor({64, 64}), b = g->addTensor({64, 64});
+    auto matmul = g->addOp<MatmulObj>(a, b, nullptr);
+    auto add = g->addOp<AddObj>(matmul->getOutput(), b, nullptr);
+    HeuristicCostModelObj model;
+    // compute time + 0.5 * memory cost - 0.2 * parallelism
+    const double matmulScore =
+        2.0 * 64 * 64 * 64 / 5e9 + 0.5 * (2 * 4096 * 0.2 + 4096) - 0.2 * 4096;
+    const double addScore =
+        4096 / 1e9 + 0.5 * (4096 * 1.1 + 4096 * 0.1) - 0.2 * 1024;
+    EXPECT_NEAR(model.estimate(matmul), matmulScore, 1e-9);
+    EXPECT_NEAR(model.estimate(add), addScore, 1e-9);
+    EXPECT_NEAR(model.estimate(g), matmulScore + addScore, 1e-9);
+}
+
+TEST(CostModel, rooflineRanking) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto a = g->addTensor({256, 256}), b = g->addTensor({256, 256});
+    auto matmul = g->addOp<MatmulObj>(a, b, nullptr);
+    auto c = g->addTensor(Shape{1 << 20}), d = g->addTensor(Shape{1 << 20});
+    auto add = g->addOp<AddObj>(c, d, nullptr);
+    // A machine with plenty of compute but little bandwidth prefers the
+    // Matmul, and the ranking flips the other way round.
+    RooflineCostModelObj computeRich(1e12, 1e9, 4);
+    EXPECT_LT(computeRich.estimate(matmul), computeRich.estimate(add));
+    RooflineCostModelObj memoryRich(1e9, 1e12, 4);
+    EXPECT_GT(memoryRich.estimate(matmul), memoryRich.estimate(add));
+    EXPECT_THROW(RooflineCostModelObj(0, 1e9, 4), Exception);
+}
+
+TEST(CostModel, calibrate) {
+    auto model = RooflineCostModelObj::calibrate();
+    EXPECT_GT(model->getPeakFlops(), 0);
+    EXPECT_GT(model->getMemBandwidth(), 0);
+    EXPECT_GE(model->getNumCores(), 1);
+
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    Tensor t0 = g->addTensor({1, 3, 32, 32});
+    Tensor t1 = g->addTensor({1, 3, 32, 32});
+    Tensor t2 = g->addTensor({1, 3, 32, 32});
+    g->addOp<AddObj>(t0, t1, nullptr);
+    g->addOp<MulObj>(t1, t2, nullptr);
+    g->dataMalloc();
+    SearchEngine searchEngine(runtime, make_ref<DummyMutator>(10), model);
+    auto result = searchEngine.run(g);
+    EXPECT_EQ(result->getOperators().size(), 2u);
+}
+
+} // namespace infini
@@ -0,0 +1,69 @@
+#include "core/cpu_allocator.h"
+#include "core/graph.h"
+#include "core/runtime.h"
+#include "operators/unary.h"
+#include "test.h"
+
+namespace infini {
+
+TEST(CpuAllocator, alignedAndMapped) {
+    CpuAllocator allocator;
+    CpuAllocConfig config;
+    config.mapThreshold = 1 << 20;
+    config.zeroFill = true;
+    allocator.setConfig(config);
+
+    auto small = static_cast<uint8_t *>(allocator.alloc(100));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(small) % config.alignment, 0u);
+    for (int i = 0; i < 100; ++i)
+        EXPECT_EQ(small[i], 0);
+    auto large = static_cast<uint8_t *>(allocator.alloc(3 << 20));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(large) % 4096, 0u);
+    EXPECT_EQ(large[(3 << 20) - 1], 0);
+
+    auto stats = allocator.getStats();
+    EXPECT_EQ(stats.allocs, 2u);
+    EXPECT_EQ(stats.mappedBytes, size_t(3 << 20));
+    EXPECT_EQ(stats.bytesInUse, 128u + (3 << 20));
+    allocator.dealloc(large);
+    allocator.dealloc(small);
+    stats = allocator.getStats();
+    EXPECT_EQ(stats.frees, 2u);
+    EXPECT_EQ(stats.bytesInUse, 0u);
+    EXPECT_EQ(stats.mappedBytes, 0u);
+    EXPECT_EQ(stats.peakBytes, 128u + (3 << 20));
+}
+
+TEST(CpuAllocator, explicitHugePageFallback) {
+    CpuAllocator allocator;
+    CpuAllocConfig config;
+    config.hugePages = HugePageMode::Explicit;
+    allocator.setConfig(config);
+    // whether or not huge pages are reserved, the buffer must be usable
+    auto ptr = static_cast<float *>(allocator.alloc(4 << 20));
+    ptr[0] = ptr[(1 << 20) - 1] = 1;
+    auto stats = allocator.getStats();
+    EXPECT_EQ(stats.hugeTlbBytes + stats.hugeTlbFallbacks * (4 << 20),
+              size_t(4 << 20));
+    allocator.dealloc(ptr);
+}
+
+TEST(CpuAllocator, graphArenas) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    size_t alignment = as<NativeCpuRuntimeObj>(runtime)
+                           ->getAllocator()
+                           .getConfig()
+                           .alignment;
+    Graph g = make_ref<GraphObj>(runtime);
+    auto x = g->addTensor({3, 7}, DataType::Float32);
+    auto y = g->addOp<ReluObj>(x, nullptr)->getOutput();
+    auto z = g->addOp<ReluObj>(y, nullptr)->getOutput();
+    g->setInPlacePlanning(false);
+    g->dataMalloc();
+    for (auto t : {x, y, z})
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(t->getRawDataPtr<void *>()) %
+                      alignment,
+                  0u);
+}
+
+} // namespace infini
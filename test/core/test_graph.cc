@@ -1,10 +1,12 @@
 #include "core/blob.h"
 #include "core/graph.h"
+#include "core/run_plan.h"
 #include "core/runtime.h"
 #include "operators/element_wise.h"
 #include "operators/matmul.h"
 #include "operators/unary.h"
 #include "test.h"
+#include "utils/data_generator.h"
 
 namespace infini {
 
@@ -149,4 +151,158 @@ TEST(Graph, test_OpVec_ctor) {
     }
 }
 
+TEST(Graph, test_OpVec_ctor_cow) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    Tensor i0 = g->addTensor({1, 2, 3}, DataType::UInt32);
+    Tensor w0 = g->addTensor({1, 3, 4}, DataType::UInt32);
+    w0->setWeight();
+    g->addOp<MatmulObj>(i0, w0, nullptr);
+    g->dataMalloc();
+    w0->copyin(vector<uint32_t>{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12});
+
+    // Data in the arena of g is copied, it is freed with g
+    Graph g1 = make_ref<GraphObj>(runtime, g->getOperators());
+    Tensor w1 = g1->getOperators()[0]->getInputs(1);
+    EXPECT_NE(w1->getDataBlob(), w0->getDataBlob());
+    EXPECT_FALSE(w0->isDataShared());
+    EXPECT_TRUE(
+        w1->equalData(vector<uint32_t>{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12}));
+
+    // Clones share a blob owning its memory until one of them is written
+    Graph g2 = make_ref<GraphObj>(runtime, g1->getOperators());
+    Tensor w2 = g2->getOperators()[0]->getInputs(1);
+    EXPECT_EQ(w2->getDataBlob(), w1->getDataBlob());
+    EXPECT_TRUE(w1->isDataShared());
+    w2->copyin(vector<uint32_t>(12, 0));
+    EXPECT_NE(w2->getDataBlob(), w1->getDataBlob());
+    EXPECT_FALSE(w1->isDataShared());
+    EXPECT_TRUE(
+        w1->equalData(vector<uint32_t>{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12}));
+    EXPECT_TRUE(w2->equalData(vector<uint32_t>(12, 0)));
+
+    // Structure-only clones carry no data
+    Graph g3 = make_ref<GraphObj>(runtime, g->getOperators(), false);
+    for (auto t : g3->getTensors())
+        EXPECT_FALSE(t->hasData());
+}
+
+TEST(Graph, run_plan) {
+    auto runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    Tensor i0 = g->addTensor({2, 3}, DataType::Float32);
+    Tensor o0 = g->addOp<ReluObj>(i0, nullptr)->getOutput();
+    g->dataMalloc();
+    i0->copyin(vector<float>{-1, 2, -3, 4, -5, 6});
+    runtime->run(g);
+    EXPECT_TRUE(o0->equalData(vector<float>{0, 2, 0, 4, 0, 6}));
+
+    // Replayed while nothing changes
+    auto plan = g->getRunPlan();
+    ASSERT_NE(plan, nullptr);
+    EXPECT_EQ(plan->getSteps().size(), 1u);
+    runtime->run(g);
+    EXPECT_EQ(g->getRunPlan(), plan);
+    EXPECT_EQ(runtime->compile(g), plan);
+
+    // Recompiled once an operand moves or the graph changes
+    i0->setDataBlob(runtime->allocBlob(i0->getBytes()));
+    i0->copyin(vector<float>{1, -2, 3, -4, 5, -6});
+    runtime->run(g);
+    EXPECT_NE(g->getRunPlan(), plan);
+    EXPECT_TRUE(o0->equalData(vector<float>{1, 0, 3, 0, 5, 0}));
+    plan = g->getRunPlan();
+    Tensor o1 = g->addOp<ReluObj>(o0, nullptr)->getOutput();
+    g->dataMalloc();
+    i0->copyin(vector<float>{1, -2, 3, -4, 5, -6});
+    runtime->run(g);
+    EXPECT_EQ(g->getRunPlan()->getSteps().size(), 2u);
+    EXPECT_TRUE(o1->equalData(vector<float>{1, 0, 3, 0, 5, 0}));
+
+    // Recompiled once an operand is reshaped, even to the same rank and size
+    plan = g->getRunPlan();
+    for (auto t : {i0, o0, o1})
+        t->setShape({3, 2});
+    runtime->run(g);
+    EXPECT_NE(g->getRunPlan(), plan);
+    EXPECT_TRUE(o1->equalData(vector<float>{1, 0, 3, 0, 5, 0}));
+}
+
+TEST(Graph, inter_op_parallel) {
+    auto runtime = NativeCpuRuntimeObj::getInstance();
+    // three projections of x, a chain on one of them, then a join
+    auto build = [&](bool concurrent) {
+        Graph g = make_ref<GraphObj>(runtime);
+        g->setInterOpParallel(concurrent);
+        auto x = g->addTensor({4, 8}, DataType::Float32);
+        TensorVec proj;
+        for (int i = 0; i < 3; ++i) {
+            auto w = g->addTensor({8, 8}, DataType::Float32);
+            w->setWeight();
+            proj.emplace_back(g->addOp<MatmulObj>(x, w, nullptr)->getOutput());
+        }
+        auto r = g->addOp<ReluObj>(proj[0], nullptr)->getOutput();
+        r = g->addOp<ReluObj>(r, nullptr)->getOutput();
+        auto s = g->addOp<AddObj>(r, proj[1], nullptr)->getOutput();
+        g->addOp<MulObj>(s, proj[2], nullptr);
+        g->dataMalloc();
+        for (auto &t : g->getTensors())
+            if (!t->getSource())
+                t->setData(IncrementalGenerator());
+        runtime->run(g);
+        return g;
+    };
+    auto serial = build(false), concurrent = build(true);
+    EXPECT_TRUE(concurrent->getOutputs()[0]->equalData(
+        serial->getOutputs()[0]));
+    auto levels = concurrent->getOpLevels();
+    EXPECT_EQ(levels, (vector<size_t>{0, 0, 0, 1, 2, 3, 4}));
+    EXPECT_EQ(concurrent->getRunPlan()->getLevels()[0].size(), 3u);
+
+    // tensors live in overlapping levels do not overlap in memory, unless
+    // one is computed in place of the other
+    auto &ops = concurrent->getOperators();
+    std::map<TensorObj *, pair<size_t, size_t>> lifetime;
+    for (size_t i = 0; i < ops.size(); ++i) {
+        for (auto &t : ops[i]->getOutputs())
+            lifetime[t.get()] = {levels[i], levels[i]};
+        for (auto &t : ops[i]->getInputs())
+            if (!t->isWeight()) {
+                auto it = lifetime.try_emplace(t.get(), 0, 0).first;
+                it->second.second = std::max(it->second.second, levels[i]);
+            }
+    }
+    for (auto &[a, la] : lifetime)
+        for (auto &[b, lb] : lifetime) {
+            if (a == b || la.second < lb.first || lb.second < la.first)
+                continue;
+            auto inPlace = [](TensorObj *in, TensorObj *out) {
+                auto source = out->getSource();
+                return source && source->getInputs(0).get() == in &&
+                       in->getTargets().size() == 1;
+            };
+            if (inPlace(a, b) || inPlace(b, a))
+                continue;
+            auto pa = a->getRawDataPtr<uint8_t *>();
+            auto pb = b->getRawDataPtr<uint8_t *>();
+            EXPECT_TRUE(pa + a->getBytes() <= pb || pb + b->getBytes() <= pa);
+        }
+}
+
+TEST(Graph, test_OpVec_ctor_outlives_source) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g2;
+    {
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor i0 = g->addTensor({1, 1024, 1024}, DataType::UInt32);
+        Tensor w0 = g->addTensor({1, 1024, 1}, DataType::UInt32);
+        g->addOp<MatmulObj>(i0, w0, nullptr);
+        g->dataMalloc();
+        i0->setData(ValGenerator<3>());
+        g2 = make_ref<GraphObj>(runtime, g->getOperators());
+    }
+    Tensor i2 = g2->getOperators()[0]->getInputs(0);
+    EXPECT_TRUE(i2->equalData(vector<uint32_t>(1024 * 1024, 3)));
+}
+
 } // namespace infini
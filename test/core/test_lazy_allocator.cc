@@ -1,6 +1,10 @@
 #include "core/graph.h"
 #include "core/kernel.h"
 #include "core/runtime.h"
+#include "operators/conv.h"
+#include "operators/element_wise.h"
+#include "operators/matmul.h"
+#include "operators/reshape.h"
 #include "operators/unary.h"
 
 #include "test.h"
@@ -93,4 +97,269 @@ TEST(LazyAllocator, testGetPtr) {
     EXPECT_EQ(ptr1, ptr2);
 }
 
+TEST(LazyAllocator, testPlanOffline) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    // online, c cannot reuse the space of a because b stays in between
+    vector<MemBlockLifetime> blocks = {
+        {256, 0, 1}, // a
+        {256, 0, 2}, // b
+        {512, 2, 3}, // c
+    };
+    LazyAllocator online = LazyAllocator(runtime);
+    size_t offsetA = online.alloc(256);
+    size_t offsetB = online.alloc(256);
+    online.free(offsetA, 256);
+    online.alloc(512);
+    online.free(offsetB, 256);
+    EXPECT_EQ(online.getPeak(), 1024);
+
+    for (auto strategy :
+         {MemPlanStrategy::GreedyBySize, MemPlanStrategy::GreedyByBreadth}) {
+        LazyAllocator allocator = LazyAllocator(runtime);
+        auto offsets = allocator.planOffline(blocks, strategy);
+        EXPECT_EQ(allocator.getLowerBound(), 768);
+        EXPECT_EQ(allocator.getPeak(), 768);
+        // blocks live at the same step must not overlap
+        for (size_t i = 0; i < blocks.size(); ++i)
+            for (size_t j = i + 1; j < blocks.size(); ++j) {
+                if (blocks[i].begin <= blocks[j].end &&
+                    blocks[j].begin <= blocks[i].end) {
+                    EXPECT_TRUE(offsets[i] + blocks[i].size <= offsets[j] ||
+                                offsets[j] + blocks[j].size <= offsets[i]);
+                }
+            }
+    }
+}
+
+TEST(LazyAllocator, testGraphMemPlanStrategy) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    vector<float> expected;
+    size_t onlinePeak = 0;
+    for (auto strategy :
+         {MemPlanStrategy::Online, MemPlanStrategy::GreedyBySize,
+          MemPlanStrategy::GreedyByBreadth}) {
+        Graph g = make_ref<GraphObj>(runtime);
+        g->setMemPlanStrategy(strategy);
+        auto x = g->addTensor({2, 16}, DataType::Float32);
+        auto a = g->addOp<ReluObj>(x, nullptr)->getOutput();
+        auto b = g->addOp<AbsObj>(x, nullptr)->getOutput();
+        auto c = g->addOp<AddObj>(a, b, nullptr)->getOutput();
+        auto d = g->addOp<ReluObj>(c, nullptr)->getOutput();
+        auto y = g->addOp<MulObj>(d, b, nullptr)->getOutput();
+        x->setInput();
+        y->setOutput();
+        g->dataMalloc();
+        x->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_GE(g->getAllocator().getPeak(),
+                  g->getAllocator().getLowerBound());
+        if (strategy == MemPlanStrategy::Online) {
+            onlinePeak = g->getAllocator().getPeak();
+            expected = y->copyout<float>();
+        } else {
+            EXPECT_LE(g->getAllocator().getPeak(), onlinePeak);
+            EXPECT_TRUE(y->equalData(expected));
+        }
+    }
+}
+
+TEST(LazyAllocator, testPlanCache) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto x = g->addTensor({2, 16}, DataType::Float32);
+    auto a = g->addOp<ReluObj>(x, nullptr)->getOutput();
+    auto b = g->addOp<AbsObj>(a, nullptr)->getOutput();
+    auto y = g->addOp<AddObj>(a, b, nullptr)->getOutput();
+    x->setInput();
+    y->setOutput();
+
+    auto mallocWithBatch = [&](int batch) {
+        x->setShape({batch, 16});
+        g->shape_infer();
+        g->dataMalloc();
+        x->setData(IncrementalGenerator());
+        runtime->run(g);
+        vector<float> ans;
+        for (int i = 0; i < batch * 16; ++i)
+            ans.emplace_back(i * 2);
+        EXPECT_TRUE(y->equalData(ans));
+        return x->getRawDataPtr<void *>();
+    };
+    mallocWithBatch(2);
+    void *largest = mallocWithBatch(8);
+    EXPECT_EQ(g->getAllocator().getPlanCacheSize(), 2);
+    size_t peak8 = g->getAllocator().getPeak();
+    // known and smaller shapes reuse their plans and the largest buffer
+    EXPECT_EQ(mallocWithBatch(2), largest);
+    EXPECT_EQ(mallocWithBatch(4), largest);
+    EXPECT_EQ(mallocWithBatch(8), largest);
+    EXPECT_EQ(g->getAllocator().getPlanCacheSize(), 3);
+    EXPECT_EQ(g->getAllocator().getPeak(), peak8);
+
+    // Rewiring changes the lifetimes, so the plans are dropped
+    auto z = g->addOp<ReluObj>(x, nullptr)->getOutput();
+    EXPECT_EQ(g->getAllocator().getPlanCacheSize(), 0);
+    g->replaceConnection(a, z, g->getOperators()[2]);
+    EXPECT_EQ(g->getAllocator().getPlanCacheSize(), 0);
+    mallocWithBatch(8);
+    EXPECT_EQ(g->getAllocator().getPlanCacheSize(), 1);
+}
+
+TEST(LazyAllocator, testViewAlias) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    for (auto strategy :
+         {MemPlanStrategy::Online, MemPlanStrategy::GreedyBySize,
+          MemPlanStrategy::GreedyByBreadth}) {
+        Graph g = make_ref<GraphObj>(runtime);
+        g->setMemPlanStrategy(strategy);
+        auto x = g->addTensor({2, 3, 4}, DataType::Float32);
+        auto a = g->addOp<NegObj>(x, nullptr)->getOutput();
+        auto b = g->addOp<ReshapeObj>(a, nullptr, Shape{6, 4})->getOutput();
+        auto c = g->addOp<FlattenObj>(b, nullptr, 1)->getOutput();
+        auto d = g->addOp<AbsObj>(c, nullptr)->getOutput();
+        // the shared buffer is still used after d is computed
+        auto y = g->addOp<AddObj>(d, c, nullptr)->getOutput();
+        x->setInput();
+        y->setOutput();
+        g->dataMalloc();
+        EXPECT_EQ(b->getRawDataPtr<void *>(), a->getRawDataPtr<void *>());
+        EXPECT_EQ(c->getRawDataPtr<void *>(), a->getRawDataPtr<void *>());
+        EXPECT_NE(d->getRawDataPtr<void *>(), a->getRawDataPtr<void *>());
+        x->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(y->equalData(vector<float>(24, 0)));
+    }
+}
+
+TEST(LazyAllocator, testInPlace) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    vector<float> expected;
+    size_t peakBefore = 0;
+    for (bool inPlace : {false, true}) {
+        Graph g = make_ref<GraphObj>(runtime);
+        g->setInPlacePlanning(inPlace);
+        auto x = g->addTensor({4, 8}, DataType::Float32);
+        auto r = g->addOp<NegObj>(x, nullptr)->getOutput();
+        auto s = g->addOp<ReluObj>(r, nullptr)->getOutput();
+        auto t = g->addOp<AddObj>(s, r, nullptr)->getOutput();
+        auto y = g->addOp<AbsObj>(t, nullptr)->getOutput();
+        x->setInput();
+        y->setOutput();
+        g->dataMalloc();
+        x->setData(IncrementalGenerator());
+        runtime->run(g);
+        if (!inPlace) {
+            peakBefore = g->getAllocator().getPeak();
+            expected = y->copyout<float>();
+            continue;
+        }
+        // r is still used by t, x and y are graph input and output
+        EXPECT_NE(s->getRawDataPtr<void *>(), r->getRawDataPtr<void *>());
+        EXPECT_EQ(t->getRawDataPtr<void *>(), s->getRawDataPtr<void *>());
+        EXPECT_NE(y->getRawDataPtr<void *>(), t->getRawDataPtr<void *>());
+        EXPECT_LT(g->getAllocator().getPeak(), peakBefore);
+        EXPECT_TRUE(y->equalData(expected));
+    }
+}
+
+// Peak activation memory of two ResNet basic blocks and a LLaMA MLP block,
+// without and with in-place planning. The ResNet peak sits at a convolution
+// whose input is still needed by the residual add, which in-place reuse
+// cannot shrink, so only the MLP is expected to improve.
+TEST(LazyAllocator, testInPlacePeak) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    auto resnetBlocks = [&](Graph g) {
+        auto x = g->addTensor({1, 64, 56, 56}, DataType::Float32);
+        x->setInput();
+        auto y = x;
+        for (int i = 0; i < 2; ++i) {
+            auto w0 = g->addTensor({64, 64, 3, 3}, DataType::Float32);
+            auto w1 = g->addTensor({64, 64, 3, 3}, DataType::Float32);
+            w0->setWeight();
+            w1->setWeight();
+            auto c0 = g->addOp<ConvObj>(y, w0, nullptr, 1, 1)->getOutput();
+            auto r0 = g->addOp<ReluObj>(c0, nullptr)->getOutput();
+            auto c1 = g->addOp<ConvObj>(r0, w1, nullptr, 1, 1)->getOutput();
+            auto sum = g->addOp<AddObj>(c1, y, nullptr)->getOutput();
+            y = g->addOp<ReluObj>(sum, nullptr)->getOutput();
+        }
+        y->setOutput();
+    };
+    auto llamaMlp = [&](Graph g) {
+        auto x = g->addTensor({1, 32, 512}, DataType::Float32);
+        auto wGate = g->addTensor({512, 1376}, DataType::Float32);
+        auto wUp = g->addTensor({512, 1376}, DataType::Float32);
+        auto wDown = g->addTensor({1376, 512}, DataType::Float32);
+        for (auto w : {wGate, wUp, wDown})
+            w->setWeight();
+        auto gate = g->addOp<MatmulObj>(x, wGate, nullptr)->getOutput();
+        auto act = g->addOp<SiluObj>(gate, nullptr)->getOutput();
+        auto up = g->addOp<MatmulObj>(x, wUp, nullptr)->getOutput();
+        auto prod = g->addOp<MulObj>(act, up, nullptr)->getOutput();
+        auto down = g->addOp<MatmulObj>(prod, wDown, nullptr)->getOutput();
+        auto y = g->addOp<AddObj>(down, x, nullptr)->getOutput();
+        x->setInput();
+        y->setOutput();
+    };
+    for (auto &[name, build, shrinks] :
+         vector<std::tuple<string, std::function<void(Graph)>, bool>>{
+             {"ResNet basic blocks", resnetBlocks, false},
+             {"LLaMA MLP", llamaMlp, true}}) {
+        size_t peak[2];
+        for (bool inPlace : {false, true}) {
+            Graph g = make_ref<GraphObj>(runtime);
+            g->setInPlacePlanning(inPlace);
+            build(g);
+            g->dataMalloc();
+            peak[inPlace] = g->getAllocator().getPeak();
+        }
+        std::cout << name << ": peak " << peak[0] << " -> " << peak[1]
+                  << " bytes" << std::endl;
+        if (shrinks)
+            EXPECT_LT(peak[1], peak[0]);
+        else
+            EXPECT_LE(peak[1], peak[0]);
+    }
+}
+
+TEST(LazyAllocator, testWeightFile) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    string path = "test_lazy_allocator_weights.bin";
+    auto build = [&](int n) {
+        Graph g = make_ref<GraphObj>(runtime);
+        auto x = g->addTensor({2, 3}, DataType::Float32);
+        auto w0 = g->addTensor({3, n}, DataType::Float32);
+        auto w1 = g->addTensor({n}, DataType::Float32);
+        w0->setWeight();
+        w1->setWeight();
+        auto y = g->addOp<MatmulObj>(x, w0, nullptr)->getOutput();
+        g->addOp<AddObj>(y, w1, nullptr);
+        return g;
+    };
+    vector<float> w0Data{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12}, w1Data{1, 2,
+                                                                        3, 4};
+    {
+        Graph g = build(4);
+        g->dataMalloc();
+        g->getTensors()[1]->copyin(w0Data);
+        g->getTensors()[2]->copyin(w1Data);
+        g->saveWeights(path);
+    }
+    for (int i = 0; i < 2; ++i) {
+        Graph g = build(4);
+        g->setWeightFile(path);
+        g->dataMalloc();
+        auto w0 = g->getTensors()[1], w1 = g->getTensors()[2];
+        EXPECT_TRUE(w0->equalData(w0Data));
+        EXPECT_TRUE(w1->equalData(w1Data));
+        // writes stay private to the mapping, the file is unchanged
+        w1->copyin(vector<float>(4, 0));
+    }
+    // a graph with another weight layout is rejected
+    Graph g = build(5);
+    g->setWeightFile(path);
+    EXPECT_ANY_THROW(g->dataMalloc());
+    std::remove(path.c_str());
+}
+
 } // namespace infini
@@ -0,0 +1,186 @@
+#include "core/hash.h"
+#include "core/perf_engine.h"
+#include "test.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <thread>
+
+namespace infini {
+
+namespace {
+PerfEngine::Key makeKey(int n) {
+    vector<int> workload{OpType::Add, n, n};
+    return {KernelAttrs{Device::CPU, OpType::Add},
+            OpPerfKey(hashVector(workload), OpType::Add, workload)};
+}
+} // namespace
+
+TEST(PerfEngine, concurrent) {
+    auto &perfEngine = PerfEngine::getInstance();
+    perfEngine.set_data({});
+    vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back([&, t]() {
+            for (int i = t; i < 1000; i += 4) {
+                perfEngine.setPerfData(makeKey(i), make_ref<PerfRecordObj>(i));
+                EXPECT_EQ(perfEngine.getPerfData(makeKey(i))->time, i);
+            }
+        });
+    for (auto &thread : threads)
+        thread.join();
+    EXPECT_EQ(perfEngine.size(), 1000u);
+    EXPECT_EQ(perfEngine.getPerfData(makeKey(1000)), nullptr);
+    EXPECT_THROW(perfEngine.setPerfData(makeKey(0), make_ref<PerfRecordObj>()),
+                 Exception);
+}
+
+TEST(PerfEngine, binary) {
+    auto &perfEngine = PerfEngine::getInstance();
+    perfEngine.set_data({});
+    perfEngine.setPerfData(makeKey(1), make_ref<PerfRecordObj>(7));
+    perfEngine.setPerfData(makeKey(2), make_ref<PerfRecordObj>(4));
+    auto path = "perf_engine_test.bin";
+    perfEngine.savePerfEngineBinary(path);
+
+    // Merge with records of another machine
+    perfEngine.set_data({});
+    perfEngine.setPerfData(makeKey(2), make_ref<PerfRecordObj>(3));
+    perfEngine.setPerfData(makeKey(3), make_ref<PerfRecordObj>(5));
+    EXPECT_EQ(perfEngine.loadPerfEngineBinary(
+                  path, PerfEngine::MergePolicy::KeepFaster),
+              1u);
+    EXPECT_EQ(perfEngine.size(), 3u);
+    EXPECT_EQ(perfEngine.getPerfData(makeKey(1))->time, 7);
+    EXPECT_EQ(perfEngine.getPerfData(makeKey(2))->time, 3);
+    EXPECT_EQ(perfEngine.loadPerfEngineBinary(path), 2u);
+    EXPECT_EQ(perfEngine.getPerfData(makeKey(2))->time, 4);
+    std::remove(path);
+}
+
+TEST(PerfEngine, append) {
+    auto &perfEngine = PerfEngine::getInstance();
+    auto path = "perf_engine_test_append.bin";
+    std::remove(path);
+    perfEngine.set_data({});
+    perfEngine.setPerfData(makeKey(1), make_ref<PerfRecordObj>(1));
+    perfEngine.attachPerfEngineBinary(path);
+    perfEngine.setPerfData(makeKey(2), make_ref<PerfRecordObj>(2));
+    perfEngine.attachPerfEngineBinary("");
+    // A record partially written by an interrupted append is ignored
+    std::ofstream(path, std::ios::app | std::ios::binary).write("\x40\0\0", 3);
+
+    perfEngine.set_data({});
+    perfEngine.attachPerfEngineBinary(path);
+    EXPECT_EQ(perfEngine.size(), 2u);
+    perfEngine.setPerfData(makeKey(3), make_ref<PerfRecordObj>(3));
+    perfEngine.attachPerfEngineBinary("");
+
+    perfEngine.set_data({});
+    EXPECT_EQ(perfEngine.loadPerfEngineBinary(path), 3u);
+    EXPECT_EQ(perfEngine.getPerfData(makeKey(3))->time, 3);
+    std::remove(path);
+}
+
+TEST(PerfEngine, corrupted) {
+    auto &perfEngine = PerfEngine::getInstance();
+    perfEngine.set_data({});
+    perfEngine.setPerfData(makeKey(1), make_ref<PerfRecordObj>(1));
+    auto path = "perf_engine_test_corrupted.bin";
+    perfEngine.savePerfEngineBinary(path);
+    string buf;
+    {
+        std::ifstream filein(path, std::ios::binary);
+        buf.assign(std::istreambuf_iterator<char>(filein),
+                   std::istreambuf_iterator<char>());
+    }
+    // file header, record size, device, op type and hash
+    const size_t sizeOffset = 12, countOffset = sizeOffset + 4 + 16;
+    ASSERT_GT(buf.size(), countOffset + 4);
+    auto loadPatched = [&](size_t offset, uint32_t value, size_t length) {
+        string patched = buf.substr(0, length);
+        std::memcpy(&patched[offset], &value, sizeof(value));
+        std::ofstream(path, std::ios::trunc | std::ios::binary)
+            .write(patched.data(), patched.size());
+        perfEngine.loadPerfEngineBinary(path);
+    };
+    // A record too short for its fixed fields
+    EXPECT_THROW(loadPatched(sizeOffset, 4, sizeOffset + 8), Exception);
+    // More attrs than the bytes of the record
+    EXPECT_THROW(loadPatched(countOffset, 0xffffffff, buf.size()), Exception);
+    std::remove(path);
+}
+
+TEST(PerfEngine, json) {
+    auto &perfEngine = PerfEngine::getInstance();
+    perfEngine.set_data({});
+    perfEngine.setPerfData(makeKey(1), make_ref<PerfRecordObj>(1));
+    json j = perfEngine;
+    // Loading should not depend on the formatting of the file
+    auto path = "perf_engine_test.json";
+    std::ofstream(path) << j.dump(4);
+    perfEngine.set_data({});
+    perfEngine.loadPerfEngineData(path);
+    EXPECT_EQ(perfEngine.size(), 1u);
+    std::remove(path);
+}
+
+TEST(PerfEngine, precision) {
+    auto &perfEngine = PerfEngine::getInstance();
+    perfEngine.set_data({});
+    TimingStats stats;
+    stats.mean = 0.125, stats.median = 0.123456789, stats.p10 = 0.1;
+    stats.p90 = 0.15, stats.stddev = 0.0123, stats.rounds = 42;
+    perfEngine.setPerfData(makeKey(1), make_ref<PerfRecordObj>(stats));
+    perfEngine.setPerfData(makeKey(2), make_ref<PerfRecordObj>(2.5));
+    auto check = [&]() {
+        auto record = perfEngine.getPerfData(makeKey(1));
+        EXPECT_EQ(record->time, 0.123456789);
+        EXPECT_EQ(record->stats.mean, 0.125);
+        EXPECT_EQ(record->stats.p10, 0.1);
+        EXPECT_EQ(record->stats.p90, 0.15);
+        EXPECT_EQ(record->stats.stddev, 0.0123);
+        EXPECT_EQ(record->stats.rounds, 42);
+        EXPECT_EQ(perfEngine.getPerfData(makeKey(2))->time, 2.5);
+        EXPECT_EQ(perfEngine.getPerfData(makeKey(2))->stats.rounds, 0);
+    };
+    auto path = "perf_engine_test_precision.json";
+    perfEngine.savePerfEngineData(path);
+    perfEngine.set_data({});
+    perfEngine.loadPerfEngineData(path);
+    check();
+    std::remove(path);
+
+    path = "perf_engine_test_precision.bin";
+    perfEngine.savePerfEngineBinary(path);
+    perfEngine.set_data({});
+    perfEngine.loadPerfEngineBinary(path);
+    check();
+    std::remove(path);
+}
+
+TEST(PerfEngine, timeitStats) {
+    volatile double sink = 0;
+    auto func = [&]() {
+        for (int i = 0; i < 10000; ++i)
+            sink = sink + i;
+    };
+    TimingConfig config;
+    config.minRounds = 8;
+    config.maxRounds = 50;
+    config.flushCache = true;
+    config.flushBytes = 1 << 20;
+    config.pinCpu = 0;
+    auto stats = timeitStats(func, {}, config);
+    EXPECT_GE(stats.rounds, 8);
+    EXPECT_LE(stats.rounds, 50);
+    EXPECT_GT(stats.median, 0);
+    EXPECT_LE(stats.p10, stats.median);
+    EXPECT_LE(stats.median, stats.p90);
+    EXPECT_GE(stats.stddev, 0);
+    auto record = PerfRecordObj(stats);
+    EXPECT_EQ(record.time, stats.median);
+}
+
+} // namespace infini
@@ -0,0 +1,96 @@
+#include "core/graph.h"
+#include "core/hash.h"
+#include "core/perf_engine.h"
+#include "core/perf_predictor.h"
+#include "core/runtime.h"
+#include "operators/element_wise.h"
+#include "operators/matmul.h"
+#include "test.h"
+#include <cstdio>
+
+namespace infini {
+
+namespace {
+// Synthetic records of Matmul whose time is proportional to b * m * n * k
+PerfPredictor::Records matmulRecords() {
+    PerfPredictor::Records records;
+    auto attrs = KernelAttrs{Device::CPU, OpType::MatMul};
+    for (int m : {16, 32, 64, 128})
+        for (int k : {16, 64, 256}) {
+            vector<int> workload{OpType::MatMul, 1, m, 64, k, 0, 0, 0};
+            OpPerfKey key(hashVector(workload), OpType::MatMul, workload);
+            double time = 1e-6 * m * 64 * k;
+            records.emplace(PerfPredictor::Key{attrs, key},
+                            make_ref<PerfRecordObj>(time));
+        }
+    return records;
+}
+} // namespace
+
+TEST(PerfPredictor, predict) {
+    PerfPredictor predictor;
+    predictor.train(matmulRecords());
+    EXPECT_EQ(predictor.getNumModels(), 1u);
+
+    auto attrs = KernelAttrs{Device::CPU, OpType::MatMul};
+    // An unseen shape inside the trained range
+    vector<int> workload{OpType::MatMul, 1, 48, 64, 128, 0, 0, 0};
+    auto key = PerfPredictor::Key{
+        attrs, OpPerfKey(hashVector(workload), OpType::MatMul, workload)};
+    auto prediction = predictor.predict(key);
+    EXPECT_NEAR(prediction.time, 1e-6 * 48 * 64 * 128,
+                0.1 * 1e-6 * 48 * 64 * 128);
+    EXPECT_GT(prediction.confidence, predictor.getConfidenceThreshold());
+    EXPECT_NE(predictor.predictRecord(key), nullptr);
+
+    // Far out of the trained range
+    vector<int> far{OpType::MatMul, 1, 4096, 64, 4096, 0, 0, 0};
+    auto farKey = PerfPredictor::Key{
+        attrs, OpPerfKey(hashVector(far), OpType::MatMul, far)};
+    EXPECT_LT(predictor.predict(farKey).confidence,
+              prediction.confidence);
+    EXPECT_EQ(predictor.predictRecord(farKey), nullptr);
+
+    // No model for the op type
+    vector<int> add{OpType::Add, 4, 4};
+    auto addKey = PerfPredictor::Key{
+        KernelAttrs{Device::CPU, OpType::Add},
+        OpPerfKey(hashVector(add), OpType::Add, add)};
+    EXPECT_EQ(predictor.predict(addKey).confidence, 0);
+
+    // Round trip through a file
+    auto path = "perf_predictor_test.json";
+    predictor.save(path);
+    PerfPredictor loaded;
+    loaded.load(path);
+    std::remove(path);
+    EXPECT_DOUBLE_EQ(loaded.predict(key).time, prediction.time);
+    EXPECT_DOUBLE_EQ(loaded.predict(key).confidence, prediction.confidence);
+}
+
+TEST(PerfPredictor, getPerfTime) {
+    auto &perfEngine = PerfEngine::getInstance();
+    auto predictor = make_ref<PerfPredictor>();
+    predictor->train(matmulRecords());
+    perfEngine.setPredictor(predictor);
+
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto a = g->addTensor({48, 128}), b = g->addTensor({128, 64});
+    auto matmul = g->addOp<MatmulObj>(a, b, nullptr);
+    auto c = g->addTensor({48, 64});
+    auto add = g->addOp<AddObj>(matmul->getOutput(), c, nullptr);
+    g->dataMalloc();
+    runtime->getPerfTime(g);
+    auto key = [&](const Operator &op) {
+        return PerfEngine::Key{
+            KernelAttrs{Device::CPU, op->getOpType().underlying()},
+            op->getOpPerfKey()};
+    };
+    // The Matmul is predicted without tuning, and the Add falls back to tuning
+    EXPECT_EQ(perfEngine.getPerfData(key(matmul)), nullptr);
+    EXPECT_NE(perfEngine.getPerfData(key(add)), nullptr);
+    perfEngine.setPredictor(nullptr);
+}
+
+} // namespace infini
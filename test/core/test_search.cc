@@ -12,6 +12,27 @@
 
 namespace infini {
 
+namespace {
+// conv -> add, followed by a second conv if `secondConv`, on 32x32 images
+Graph makeConvAddGraph(const Runtime &runtime, bool secondConv) {
+    Graph g = make_ref<GraphObj>(runtime);
+    Tensor t0 = g->addTensor({1, 3, 32, 32});
+    Tensor w0 = g->addTensor({3, 3, 3, 3});
+    Tensor t1 = g->addTensor({1, 3, 32, 32});
+    Tensor t2 = g->addTensor({1, 3, 32, 32});
+    Tensor t3 = g->addTensor({1, 3, 32, 32});
+    g->addOpWithOutputs<ConvObj>(t0, w0, t1, 1, 1);
+    g->addOpWithOutputs<AddObj>(t1, t2, t3);
+    if (secondConv) {
+        Tensor w3 = g->addTensor({3, 3, 3, 3});
+        Tensor t4 = g->addTensor({1, 3, 32, 32});
+        g->addOpWithOutputs<ConvObj>(t3, w3, t4, 1, 1);
+    }
+    g->dataMalloc();
+    return g;
+}
+} // namespace
+
 // TEST(Graph, search) {
 //     Runtime runtime = NativeCpuRuntimeObj::getInstance();
 //     Graph g = make_ref<GraphObj>(runtime);
@@ -52,6 +73,52 @@ TEST(Graph, search_withdm) {
     // check execution results
 }
 
+TEST(Graph, search_costCache) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = makeConvAddGraph(runtime, false);
+    SearchEngine searchEngine(runtime, make_ref<DummyMutator>(10));
+    searchEngine.run(g);
+    size_t numEvaluations = searchEngine.getNumCostEvaluations();
+    EXPECT_GT(numEvaluations, 0u);
+    // The cache and the counter are reset on each run
+    searchEngine.run(g);
+    EXPECT_EQ(searchEngine.getNumCostEvaluations(), numEvaluations);
+}
+
+TEST(Graph, search_parallelDeterministic) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = makeConvAddGraph(runtime, true);
+    vector<vector<OpType>> opTypes;
+    vector<double> perfTimes;
+    for (int numThreads : {1, 4}) {
+        SearchEngine searchEngine(runtime, make_ref<DummyMutator>(10));
+        searchEngine.setNumThreads(numThreads);
+        auto best = searchEngine.run(g);
+        vector<OpType> types;
+        for (auto &op : best->getOperators())
+            types.emplace_back(op->getOpType());
+        opTypes.emplace_back(types);
+        perfTimes.emplace_back(runtime->getPerfTime(best));
+    }
+    EXPECT_EQ(opTypes[0], opTypes[1]);
+    EXPECT_EQ(perfTimes[0], perfTimes[1]);
+}
+
+TEST(Graph, search_beam) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = makeConvAddGraph(runtime, true);
+    SearchEngine exhaustive(runtime, make_ref<DummyMutator>(10));
+    auto expected = exhaustive.run(g);
+    SearchEngine beam(runtime, make_ref<DummyMutator>(10));
+    beam.setBeamSearch(true, 4);
+    auto result = beam.run(g);
+    EXPECT_EQ(result->getOperators().size(), expected->getOperators().size());
+    EXPECT_NEAR(runtime->getPerfTime(result), runtime->getPerfTime(expected),
+                1e-9);
+    EXPECT_LT(beam.getNumCostEvaluations(),
+              exhaustive.getNumCostEvaluations());
+}
+
 // TEST(DummyMutator, run) {
 //     Runtime runtime = NativeCpuRuntimeObj::getInstance();
 //     Graph g = make_ref<GraphObj>(runtime);
@@ -0,0 +1,67 @@
+#include "core/graph.h"
+#include "core/runtime.h"
+#include "core/trace.h"
+#include "operators/matmul.h"
+#include "operators/unary.h"
+#include "test.h"
+#include "utils/data_generator.h"
+#include <cstdio>
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+namespace infini {
+
+TEST(Trace, recordAndExport) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto a = g->addTensor({1, 4, 8}, DataType::Float32);
+    auto b = g->addTensor({1, 8, 2}, DataType::Float32);
+    auto matmul = g->addOp<MatmulObj>(a, b, nullptr);
+    auto relu = g->addOp<ReluObj>(matmul->getOutput(), nullptr);
+    g->dataMalloc();
+    a->setData(IncrementalGenerator());
+    b->setData(IncrementalGenerator());
+
+    auto &tracer = Tracer::getInstance();
+    tracer.clear();
+    runtime->run(g);
+    EXPECT_TRUE(tracer.getEvents().empty());
+
+    tracer.setEnabled(true);
+    runtime->run(g);
+    tracer.setEnabled(false);
+    auto events = tracer.getEvents();
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_EQ(events[0].name, "MatMul#" + std::to_string(matmul->getGuid()));
+    EXPECT_EQ(events[0].type, OpType::MatMul);
+    EXPECT_EQ(events[0].bytes, (32u + 16u + 8u) * 4);
+    EXPECT_EQ(events[1].type, OpType::Relu);
+    EXPECT_EQ(events[1].bytes, 2u * 8 * 4);
+    for (auto &e : events) {
+        EXPECT_FALSE(e.kernel.empty());
+        EXPECT_LE(e.start, e.end);
+    }
+    EXPECT_LE(events[0].end, events[1].start);
+
+    string json = "trace_test.json", csv = "trace_test.csv";
+    tracer.exportChromeTrace(json);
+    tracer.exportCsv(csv);
+    auto trace = nlohmann::json::parse(std::ifstream(json));
+    ASSERT_EQ(trace["traceEvents"].size(), 2u);
+    EXPECT_EQ(trace["traceEvents"][1]["cat"], "Relu");
+    EXPECT_EQ(trace["traceEvents"][1]["ph"], "X");
+    std::ifstream csvFile(csv);
+    int lines = 0;
+    for (string line; std::getline(csvFile, line);)
+        ++lines;
+    EXPECT_EQ(lines, 3);
+    std::remove(json.c_str());
+    std::remove(csv.c_str());
+    tracer.clear();
+
+    // profiling without tuning traces into its own tracer
+    runtime->run(g, false, true);
+    EXPECT_TRUE(tracer.getEvents().empty());
+}
+
+} // namespace infini
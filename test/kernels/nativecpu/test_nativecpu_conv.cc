@@ -0,0 +1,138 @@
+#include "core/graph.h"
+#include "core/kernel.h"
+#include "core/perf_engine.h"
+#include "core/runtime.h"
+#include "operators/conv.h"
+
+#include "test.h"
+
+namespace infini {
+
+namespace {
+vector<float> convReference(const Ref<ConvObj> &op) {
+    auto input = op->getInputs(0)->copyout<float>();
+    auto weight = op->getInputs(1)->copyout<float>();
+    auto [n, c, h, w, f, r, s] = op->getNCHWFRS();
+    auto [ph, pw, sh, sw, dh, dw] = op->getPadStrideDilation();
+    int cpg = op->getChannelPerGroup(), fpg = f / op->getNumGroups();
+    auto outDim = op->getOutput()->getDims();
+    int oh = outDim[2], ow = outDim[3];
+    vector<float> ret(op->getOutput()->size());
+    for (int nn = 0; nn < n; ++nn)
+        for (int ff = 0; ff < f; ++ff)
+            for (int y = 0; y < oh; ++y)
+                for (int x = 0; x < ow; ++x) {
+                    float sum = 0;
+                    for (int cc = 0; cc < cpg; ++cc)
+                        for (int rr = 0; rr < r; ++rr)
+                            for (int ss = 0; ss < s; ++ss) {
+                                int iy = y * sh + rr * dh - ph;
+                                int ix = x * sw + ss * dw - pw;
+                                if (iy < 0 || iy >= h || ix < 0 || ix >= w)
+                                    continue;
+                                int ic = ff / fpg * cpg + cc;
+                                sum += input[((nn * c + ic) * h + iy) * w +
+                                             ix] *
+                                       weight[((ff * cpg + cc) * r + rr) * s +
+                                              ss];
+                            }
+                    if (op->getAct() == ActType::Relu)
+                        sum = std::max(sum, 0.f);
+                    ret[((nn * f + ff) * oh + y) * ow + x] = sum;
+                }
+    return ret;
+}
+
+// The algorithm used before tuning depends on the shape, and tuning may pick
+// any applicable one
+void testConv(const Shape &shapeInput, const Shape &shapeWeight, int ph,
+              int pw, int sh, int sw, int dh, int dw,
+              ActType act = ActType::None) {
+    for (bool tune : {false, true}) {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        auto i0 = g->addTensor(shapeInput, DataType::Float32);
+        auto w0 = g->addTensor(shapeWeight, DataType::Float32);
+        auto conv = g->addOp<ConvObj>(i0, w0, nullptr, ph, pw, sh, sw, dh, dw,
+                                      nullptr, act);
+        g->dataMalloc();
+        i0->setData(RandomGenerator(-1, 1, 0));
+        w0->setData(RandomGenerator(-1, 1, 1));
+        runtime->run(g, tune);
+        auto expected = convReference(conv);
+        auto result = conv->getOutput()->copyout<float>();
+        for (size_t i = 0; i < result.size(); ++i)
+            ASSERT_NEAR(result[i], expected[i], 1e-4) << "at " << i;
+    }
+}
+
+// Runs op with a record which picks `algo`, the index of an algorithm of the
+// kernel, as a record loaded from a file would
+void testConvWith(int algo, const Shape &shapeInput, const Shape &shapeWeight,
+                  int ph, int pw, ActType act = ActType::None) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto i0 = g->addTensor(shapeInput, DataType::Float32);
+    auto w0 = g->addTensor(shapeWeight, DataType::Float32);
+    auto conv = g->addOp<ConvObj>(i0, w0, nullptr, ph, pw, 1, 1, 1, 1,
+                                  nullptr, act);
+    g->dataMalloc();
+    i0->setData(RandomGenerator(-1, 1, 0));
+    w0->setData(RandomGenerator(-1, 1, 1));
+    json j{{"type", 3}, {"data", 1.0}, {"algo", algo}};
+    PerfEngine::getInstance().setPerfData(
+        {KernelAttrs{Device::CPU, conv->getOpType().underlying()},
+         conv->getOpPerfKey()},
+        PerfRecordRegistry::getInstance().getConstructor(3)(j));
+    runtime->run(g);
+    auto expected = convReference(conv);
+    auto result = conv->getOutput()->copyout<float>();
+    for (size_t i = 0; i < result.size(); ++i)
+        ASSERT_NEAR(result[i], expected[i], 1e-4) << "at " << i;
+}
+} // namespace
+
+TEST(Conv, NativeCpuIm2col) {
+    testConv({2, 3, 11, 13}, {5, 3, 3, 2}, 1, 0, 2, 1, 1, 2);
+    testConv({1, 4, 9, 9}, {6, 2, 3, 3}, 1, 1, 1, 1, 1, 1, ActType::Relu);
+}
+
+TEST(Conv, NativeCpuPointwise) {
+    testConv({2, 8, 7, 5}, {6, 8, 1, 1}, 0, 0, 1, 1, 1, 1);
+}
+
+TEST(Conv, NativeCpuDepthwise) {
+    testConv({2, 6, 12, 17}, {6, 1, 3, 3}, 1, 1, 1, 1, 1, 1, ActType::Relu);
+    testConv({1, 4, 12, 17}, {4, 1, 5, 3}, 2, 1, 2, 2, 1, 2);
+}
+
+TEST(Conv, NativeCpuWinograd) {
+    testConv({2, 5, 13, 10}, {7, 5, 3, 3}, 1, 1, 1, 1, 1, 1);
+    testConv({1, 3, 8, 9}, {4, 3, 3, 3}, 0, 2, 1, 1, 1, 1, ActType::Relu);
+    // F(2x2, 3x3) and F(4x4, 3x3)
+    testConvWith(4, {2, 5, 13, 10}, {7, 5, 3, 3}, 1, 0);
+    testConvWith(4, {1, 3, 8, 9}, {4, 3, 3, 3}, 2, 0, ActType::Relu);
+    testConvWith(5, {2, 5, 13, 10}, {7, 5, 3, 3}, 0, 1);
+    testConvWith(5, {1, 3, 8, 9}, {4, 3, 3, 3}, 1, 2, ActType::Relu);
+}
+
+TEST(Conv, NativeCpuTunedRecord) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto i0 = g->addTensor({1, 4, 10, 10}, DataType::Float32);
+    auto w0 = g->addTensor({4, 4, 3, 3}, DataType::Float32);
+    auto conv = g->addOp<ConvObj>(i0, w0, nullptr, 1, 1);
+    g->dataMalloc();
+    auto kernel = KernelRegistry::getInstance().getKernel(
+        {Device::CPU, conv->getOpType().underlying()});
+    // The algorithm survives serialization
+    json j, loaded;
+    kernel->tune(conv, runtime.get())->to_json(j);
+    ASSERT_TRUE(j.contains("algo"));
+    PerfRecordRegistry::getInstance()
+        .getConstructor(j["type"])(j)
+        ->to_json(loaded);
+    EXPECT_EQ(loaded, j);
+}
+
+} // namespace infini
@@ -41,4 +41,25 @@ TEST(ElementWise, NativeCpu) {
         Shape{2, 1, 1}, ExpectOutput{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11});
 }
 
+TEST(ElementWise, NativeCpuBroadcast) {
+    // Both inputs are broadcast, along different dimensions
+    Shape shapeA{2, 3, 1, 4}, shapeB{3, 5, 1}, shapeC{2, 3, 5, 4};
+    ExpectOutput ans;
+    for (int i = 0; i < 2; ++i)
+        for (int j = 0; j < 3; ++j)
+            for (int k = 0; k < 5; ++k)
+                for (int l = 0; l < 4; ++l)
+                    ans.emplace_back((i * 12 + j * 4 + l) - (j * 5 + k));
+    testElementWiseNativeCpu<SubObj>(IncrementalGenerator(),
+                                     IncrementalGenerator(), shapeA, shapeB,
+                                     ans);
+
+    // Large enough to be split into blocks over the threads
+    ExpectOutput big(70000);
+    for (size_t i = 0; i < big.size(); ++i)
+        big[i] = i * 2.f;
+    testElementWiseNativeCpu<MulObj>(IncrementalGenerator(), ValGenerator<2>(),
+                                     Shape{7, 10000}, Shape{1}, big);
+}
+
 } // namespace infini
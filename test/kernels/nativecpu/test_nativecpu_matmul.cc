@@ -0,0 +1,105 @@
+#include "core/graph.h"
+#include "core/runtime.h"
+#include "operators/matmul.h"
+
+#include "test.h"
+
+namespace infini {
+
+namespace {
+// Reference of op(A) * op(B) + bias with the activation, for batch-broadcast
+// inputs
+vector<float> matmulReference(const Tensor &A, const Tensor &B,
+                              const Tensor &bias, const Tensor &C, bool transA,
+                              bool transB, ActType act) {
+    auto a = A->copyout<float>(), b = B->copyout<float>();
+    auto c = bias ? bias->copyout<float>() : vector<float>{};
+    auto outDims = C->getDims();
+    int rank = outDims.size();
+    int K = transA ? A->getDims().end()[-2] : A->getDims().back();
+    auto offset = [&](const Shape &dims, const vector<int> &index) {
+        size_t ret = 0, stride = 1;
+        for (int i = dims.size() - 1, j = rank - 1; i >= 0; --i, --j) {
+            ret += (dims[i] == 1 ? 0 : index[j]) * stride;
+            stride *= dims[i];
+        }
+        return ret;
+    };
+    vector<float> ret(C->size());
+    vector<int> index(rank, 0);
+    for (size_t e = 0; e < ret.size(); ++e) {
+        for (int d = rank - 1, rest = e; d >= 0; --d) {
+            index[d] = rest % outDims[d];
+            rest /= outDims[d];
+        }
+        int i = index[rank - 2], j = index[rank - 1];
+        float sum = 0;
+        for (int k = 0; k < K; ++k) {
+            auto ia = index, ib = index;
+            ia[rank - 2] = transA ? k : i, ia[rank - 1] = transA ? i : k;
+            ib[rank - 2] = transB ? j : k, ib[rank - 1] = transB ? k : j;
+            sum += a[offset(A->getDims(), ia)] * b[offset(B->getDims(), ib)];
+        }
+        if (bias)
+            sum += c[offset(bias->getDims(), index)];
+        if (act == ActType::Relu)
+            sum = std::max(sum, 0.f);
+        else if (act == ActType::Sigmoid)
+            sum = 1 / (1 + std::exp(-sum));
+        ret[e] = sum;
+    }
+    return ret;
+}
+
+void testMatmul(const Shape &shapeA, const Shape &shapeB, bool transA,
+                bool transB, const Shape &shapeBias = {},
+                ActType act = ActType::None) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto A = g->addTensor(shapeA, DataType::Float32);
+    auto B = g->addTensor(shapeB, DataType::Float32);
+    Tensor bias = shapeBias.empty()
+                      ? nullptr
+                      : g->addTensor(shapeBias, DataType::Float32);
+    auto op = g->addOp<MatmulObj>(A, B, nullptr, transA, transB, bias, act);
+    g->dataMalloc();
+    A->setData(RandomGenerator(-1, 1, 0));
+    B->setData(RandomGenerator(-1, 1, 1));
+    if (bias)
+        bias->setData(RandomGenerator(-1, 1, 2));
+    runtime->run(g);
+    auto C = op->getOutput();
+    auto expected = matmulReference(A, B, bias, C, transA, transB, act);
+    auto result = C->copyout<float>();
+    ASSERT_EQ(result.size(), expected.size());
+    for (size_t i = 0; i < result.size(); ++i)
+        ASSERT_NEAR(result[i], expected[i], 1e-4) << "at " << i;
+}
+} // namespace
+
+TEST(Matmul, NativeCpu) {
+    // Sizes are not multiples of the register and cache tiles
+    testMatmul({37, 300}, {300, 150}, false, false);
+    testMatmul({300, 37}, {150, 300}, true, true);
+    testMatmul({2, 3, 5, 7}, {3, 7, 9}, false, false);
+    testMatmul({1, 7, 5}, {4, 9, 7}, true, true);
+    testMatmul({70, 20}, {20, 130}, false, false, {130}, ActType::Relu);
+    testMatmul({2, 17, 20}, {20, 19}, false, false, {2, 17, 1},
+               ActType::Sigmoid);
+}
+
+TEST(Matmul, NativeCpuUInt32) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto A = g->addTensor({1, 2, 3}, DataType::UInt32);
+    auto B = g->addTensor({1, 3, 4}, DataType::UInt32);
+    auto op = g->addOp<MatmulObj>(A, B, nullptr);
+    g->dataMalloc();
+    A->copyin(vector<uint32_t>{1, 2, 3, 4, 5, 6});
+    B->copyin(vector<uint32_t>{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12});
+    runtime->run(g);
+    EXPECT_TRUE(op->getOutput()->equalData(
+        vector<uint32_t>{38, 44, 50, 56, 83, 98, 113, 128}));
+}
+
+} // namespace infini
@@ -1,4 +1,6 @@
+#include "nnet/Visitor/CostVisitor.h"
 #include "nnet/Visitor/CountRoutineVisitor.h"
+#include "nnet/Visitor/HashVisitor.h"
 #include "nnet/derivator.h"
 #include "nnet/expr.h"
 #include "nnet/test.h"
@@ -281,3 +283,83 @@ TEST(Conv2gemm1x7, NCHW_FCRS_search) {
         "test/nnet/log/conv2gemm_1x7/Conv2gemm_1x7_NCHW_FCRS_11.expr");
     EXPECT_GE(nMatches, 1);
 }
+
+// A 3x3 conv A[n,h+r,w+s,c]*K[r,s,f,c] on a 7x7 image with 32 channels,
+// small enough to search exhaustively
+static RangeOp makeSmallConv() {
+    int N = 1, H = 7, W = 7, C = 32, F = 32, R = 3, S = 3;
+    DEFINE_VAR(n, c, h, w, f, r, s);
+    auto A = make_ref<TensorNode>("A", vector<int>({N, H, W, C}),
+                                  vector<int>{0, R / 2, S / 2, 0});
+    auto K = make_ref<TensorNode>("K", vector<int>({R, S, F, C}));
+
+    auto subA = makeSubscript(A, {n, h + r - R / 2, w + s - S / 2, c});
+    auto subK = makeSubscript(K, {r, s, f, c});
+
+    return makeRangeOperator(
+        {{n, {0, N}}, {h, {0, H}}, {w, {0, W}}, {f, {0, F}}},
+        {{c, {0, C}}, {r, {0, R}}, {s, {0, S}}}, subA * subK);
+}
+
+TEST(Conv2gemm, parallel_search) {
+    auto range = makeSmallConv();
+
+    // Fresh iterators and tensors are named in the order states are derived.
+    // HashVisitor identifies iterators by position and derived tensors by
+    // their source, so it compares the structure of candidates.
+    auto hashes = [&](bool enableHashPruning, int spawnDepth) {
+        Formula conv(range, 0);
+        Derivator derivator(5, enableHashPruning);
+        derivator.setParallelSearch(spawnDepth);
+        derivator.search(conv, 0);
+        // the formula is restored after search
+        EXPECT_EQ(HashVisitor().getHash(conv.root),
+                  HashVisitor().getHash(range));
+        vector<HashType> ret;
+        for (const auto &formula : derivator.getCandidates())
+            ret.emplace_back(HashVisitor().getHash(formula.root));
+        return ret;
+    };
+    for (bool enableHashPruning : {false, true}) {
+        auto serial = hashes(enableHashPruning, 0);
+        ASSERT_GE(serial.size(), 1u);
+        EXPECT_EQ(hashes(enableHashPruning, 3), serial);
+    }
+}
+
+TEST(Conv2gemm, best_first_search) {
+    auto range = makeSmallConv();
+
+    auto costs = [](const Derivator &derivator) {
+        vector<double> ret;
+        for (const auto &formula : derivator.getCandidates())
+            ret.emplace_back(CostVisitor().estimate(formula.root));
+        return ret;
+    };
+    Formula conv(range, 0);
+    Derivator exhaustive(7);
+    exhaustive.search(conv, 0);
+    auto allCosts = costs(exhaustive);
+    ASSERT_GE(allCosts.size(), 1u);
+    const double best = *std::min_element(allCosts.begin(), allCosts.end());
+
+    for (double slack : {1., 1.2}) {
+        Derivator bestFirst(7);
+        bestFirst.setBestFirstSearch(slack);
+        bestFirst.search(conv, 0);
+        auto found = costs(bestFirst);
+        ASSERT_GE(found.size(), 1u);
+        // Cheapest first, and none beyond the slack
+        EXPECT_DOUBLE_EQ(found[0], best);
+        EXPECT_TRUE(std::is_sorted(found.begin(), found.end()));
+        EXPECT_LE(found.back(), best * slack);
+        EXPECT_EQ(found.size(),
+                  std::count_if(allCosts.begin(), allCosts.end(),
+                                [&](double cost) {
+                                    return cost <= best * slack;
+                                }));
+        EXPECT_GT(bestFirst.getNumPrunedStates(), 0);
+        EXPECT_LT(bestFirst.getNumIntermediateStates(),
+                  exhaustive.getNumIntermediateStates());
+    }
+}
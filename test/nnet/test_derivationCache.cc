@@ -0,0 +1,102 @@
+#include "core/graph.h"
+#include "core/runtime.h"
+#include "nnet/Visitor/HashVisitor.h"
+#include "nnet/derivation_cache.h"
+#include "nnet/derivator.h"
+#include "nnet/nmutator.h"
+#include "nnet/test.h"
+#include "operators/conv.h"
+#include "test.h"
+#include <filesystem>
+#include <fstream>
+
+using namespace infini;
+using namespace std;
+
+static string makeCacheDir(const string &name) {
+    auto dir = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove_all(dir);
+    return dir.string();
+}
+
+TEST(DerivationCache, StoreAndLoad) {
+    using namespace nnet;
+    const int N = 1, C = 4, H = 6, W = 6, F = 8, R = 3, S = 3;
+    auto A = makeTensor("A", {N, C, H, W}, {0, 0, R / 2, S / 2});
+    auto K = makeTensor("K", {F, C, R, S});
+    Formula conv(ConvPattern::getExpr(A, K, N, C, H, W, F, R, S), 0);
+    Derivator derivator(4);
+    derivator.search(conv, 0);
+    VecExpr candidates;
+    for (const auto &candidate : derivator.getCandidates())
+        candidates.emplace_back(candidate.root);
+    ASSERT_GT(candidates.size(), 0u);
+
+    auto dir = makeCacheDir("nnet_derivation_cache_test");
+    DerivationCache cache(dir);
+    EXPECT_FALSE(cache.load("conv"));
+    cache.store("conv", candidates);
+    auto loaded = cache.load("conv");
+    ASSERT_TRUE(loaded);
+    ASSERT_EQ(loaded->size(), candidates.size());
+    for (size_t i = 0; i < candidates.size(); ++i)
+        EXPECT_EQ(HashVisitor().dispatch((*loaded)[i]),
+                  HashVisitor().dispatch(candidates[i]));
+    EXPECT_FALSE(cache.load("conv;maxDepth=5"));
+    // A new instance, as in another process, reads the same entries
+    EXPECT_TRUE(DerivationCache(dir).load("conv"));
+    std::filesystem::remove_all(dir);
+}
+
+TEST(DerivationCache, UnusableDirectory) {
+    using namespace nnet;
+    // A regular file where the cache directory should be
+    auto dir = makeCacheDir("nnet_derivation_cache_file");
+    std::ofstream(dir) << "not a directory";
+    auto A = makeTensor("A", {4, 4});
+    DerivationCache cache(dir);
+    EXPECT_NO_THROW(cache.store("key", {A}));
+    EXPECT_FALSE(cache.load("key"));
+    std::filesystem::remove_all(dir);
+}
+
+TEST(DerivationCache, NMutatorSkipsDerivation) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto i0 = g->addTensor({1, 4, 6, 6}, DataType::Float32);
+    auto w0 = g->addTensor({8, 4, 3, 3}, DataType::Float32);
+    g->addOp<ConvObj>(i0, w0, nullptr, 1, 1);
+
+    auto dir = makeCacheDir("nnet_derivation_cache_mutator_test");
+    NMutator first;
+    first.setMaxDepth(4);
+    first.setDerivationCache(dir);
+    auto derived = first.run(g);
+    EXPECT_EQ(first.cntCacheHits, 0);
+    EXPECT_GT(first.cntStates, 0);
+    EXPECT_GT(derived.size(), 1u);
+
+    NMutator second;
+    second.setMaxDepth(4);
+    second.setDerivationCache(dir);
+    auto cached = second.run(g);
+    EXPECT_EQ(second.cntCacheHits, 1);
+    EXPECT_EQ(second.cntStates, 0);
+    EXPECT_EQ(second.cntCandidates, first.cntCandidates);
+    ASSERT_EQ(cached.size(), derived.size());
+    for (size_t i = 0; i < cached.size(); ++i) {
+        const auto &ops0 = derived[i]->getOperators(),
+                   &ops1 = cached[i]->getOperators();
+        ASSERT_EQ(ops0.size(), ops1.size());
+        for (size_t j = 0; j < ops0.size(); ++j)
+            EXPECT_EQ(ops0[j]->getOpType(), ops1[j]->getOpType());
+    }
+
+    // Another depth is another derivation
+    NMutator deeper;
+    deeper.setMaxDepth(5);
+    deeper.setDerivationCache(dir);
+    deeper.run(g);
+    EXPECT_EQ(deeper.cntCacheHits, 0);
+    std::filesystem::remove_all(dir);
+}
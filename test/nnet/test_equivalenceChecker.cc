@@ -0,0 +1,47 @@
+#include "nnet/derivator.h"
+#include "nnet/equivalence_checker.h"
+#include "nnet/expr.h"
+#include "nnet/iterator_table.h"
+#include "nnet/test.h"
+#include "gtest/gtest.h"
+using namespace nnet;
+using namespace std;
+
+TEST(EquivalenceChecker, SampledConv) {
+    // The output has far more positions than the sample
+    const int N = 4, C = 8, H = 56, W = 56, F = 16, R = 3, S = 3;
+    DEFINE_VAR(n, c, h, w, f, r, s);
+    auto A = makeTensor("A", {N, C, H, W}, {0, 0, R / 2, S / 2});
+    auto K = makeTensor("K", {F, C, R, S});
+    auto conv = ConvPattern::getExpr(A, K, N, C, H, W, F, R, S);
+    const vector<VarRangePair> loops{
+        {n, {0, N}}, {f, {0, F}}, {h, {0, H}}, {w, {0, W}}};
+
+    // The same conv with r and s ranging over the offsets
+    auto offsetConv = makeRangeOperator(
+        loops,
+        {{c, {0, C}}, {r, {-R / 2, R - R / 2}}, {s, {-S / 2, S - S / 2}}},
+        makeSubscript(K, {f, c, r + R / 2, s + S / 2}) *
+            makeSubscript(A, {n, c, h + r, w + s}));
+    EXPECT_TRUE(EquivalenceChecker().check({conv, offsetConv}));
+
+    // Flipped kernels
+    auto flipped = makeRangeOperator(
+        loops, {{c, {0, C}}, {r, {0, R}}, {s, {0, S}}},
+        makeSubscript(A, {n, c, h + r - R / 2, w + s - S / 2}) *
+            makeSubscript(K, {f, c, R - 1 - r, S - 1 - s}));
+    EXPECT_FALSE(EquivalenceChecker().check({conv, offsetConv, flipped}));
+    EXPECT_FALSE(EquivalenceChecker(64, 1).check({conv, flipped}));
+}
+
+TEST(EquivalenceChecker, DerivationWithCheck) {
+    const int N = 1, C = 8, H = 7, W = 7, F = 8, R = 3, S = 3;
+    auto A = makeTensor("A", {N, C, H, W}, {0, 0, R / 2, S / 2});
+    auto K = makeTensor("K", {F, C, R, S});
+    Formula conv(ConvPattern::getExpr(A, K, N, C, H, W, F, R, S), 0);
+    // Aborts on an inequivalent intermediate state
+    Derivator derivator(6);
+    derivator.setEquivalenceCheck();
+    derivator.search(conv, 0);
+    EXPECT_GT(derivator.getNumCandidates(), 0);
+}
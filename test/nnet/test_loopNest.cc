@@ -0,0 +1,109 @@
+#include "core/graph.h"
+#include "core/runtime.h"
+#include "nnet/Visitor/Interpreter.h"
+#include "nnet/iterator_table.h"
+#include "nnet/loop_nest.h"
+#include "nnet/nmutator.h"
+#include "nnet/test.h"
+#include "operators/matmul.h"
+#include "test.h"
+
+using namespace nnet;
+using namespace std;
+
+// Evaluate range with the LoopNest and with the Interpreter, both on inputs
+// filled with 0, 1, 2, ...
+static void checkWithInterpreter(const RangeOp &range,
+                                 const vector<Tensor> &tensors) {
+    vector<vector<int>> data;
+    Interpreter::Inputs interpreterInputs;
+    for (const auto &tensor : tensors) {
+        auto &d = data.emplace_back(tensor->getSize());
+        for (size_t i = 0; i < d.size(); ++i)
+            d[i] = i;
+        interpreterInputs.emplace(tensor->getName(),
+                                  nnet::make_ref<vector<int>>(d));
+    }
+    vector<const int *> inputs;
+    for (const auto &d : data)
+        inputs.emplace_back(d.data());
+    LoopNest nest(range, tensors);
+    vector<int> output(nest.getOutputSize());
+    nest.run(inputs, output.data());
+    auto ans = Interpreter(interpreterInputs).interpretAllOutput(range);
+    EXPECT_EQ(output, ans);
+}
+
+TEST(LoopNest, ConvWithPadding) {
+    const int N = 2, C = 3, H = 5, W = 5, F = 4, R = 3, S = 3;
+    auto A = makeTensor("A", {N, C, H, W}, {0, 0, R / 2, S / 2});
+    auto K = makeTensor("K", {F, C, R, S});
+    auto range =
+        as<RangeOpNode>(ConvPattern::getExpr(A, K, N, C, H, W, F, R, S));
+    checkWithInterpreter(range, {A, K});
+}
+
+TEST(LoopNest, NestedStage) {
+    // Transpose A with padding in an inner stage and convolve it in 1D
+    const int N = 2, H = 4, W = 33;
+    DEFINE_VAR(n, h, w, s);
+    auto A = makeTensor("A", {N, H, W});
+    auto K = makeTensor("K", {3});
+    auto inner = makeRangeOperator({{n, {0, N}}, {w, {0, W}}, {h, {0, H}}},
+                                   {}, makeSubscript(A, {n, h, w}), {0, 1, 0});
+    auto range = makeRangeOperator(
+        {{n, {0, N}}, {h, {0, H}}, {w, {0, W}}}, {{s, {0, 3}}},
+        makeSubscript(inner, {n, w + s - 1, h}) * makeSubscript(K, {s}));
+    checkWithInterpreter(range, {A, K});
+
+    // The same without the inner stage
+    auto paddedA = makeTensor("A", {N, H, W}, {0, 0, 1});
+    auto flat = makeRangeOperator({{n, {0, N}}, {h, {0, H}}, {w, {0, W}}},
+                                  {{s, {0, 3}}},
+                                  makeSubscript(paddedA, {n, h, w + s - 1}) *
+                                      makeSubscript(K, {s}));
+    vector<int> a(N * H * W), k{1, 10, 100};
+    for (size_t i = 0; i < a.size(); ++i)
+        a[i] = i;
+    vector<int> out(N * H * W), outFlat(N * H * W);
+    LoopNest(range, {A, K}).run<int>({a.data(), k.data()}, out.data());
+    LoopNest(flat, {paddedA, K}).run<int>({a.data(), k.data()},
+                                          outFlat.data());
+    EXPECT_EQ(out, outFlat);
+}
+
+TEST(LoopNest, DivAndModIndex) {
+    const int N = 3, H = 40, W = 50;
+    DEFINE_VAR(i);
+    auto A = makeTensor("A", {N, H, W});
+    auto range = makeRangeOperator(
+        {{i, {0, N * H * W}}}, {},
+        makeSubscript(A, {i / (H * W), (i / W) % H, i % W}) + 1);
+    checkWithInterpreter(range, {A});
+}
+
+namespace infini {
+
+TEST(LoopNest, MemboundKernel) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto i0 = g->addTensor({2, 40, 30}, DataType::Float32);
+    auto w0 = g->addTensor({2, 30, 50}, DataType::Float32);
+    g->addOp<MatmulObj>(i0, w0, nullptr);
+    NMutator nmutator(NMutator::Mode::ToNaiveMembound);
+    auto mutations = nmutator.run(g);
+    ASSERT_EQ(mutations.size(), 2u);
+    Graph gNew = mutations[1];
+    ASSERT_EQ(gNew->getOperators()[0]->getOpType(), OpType::MemBound);
+
+    g->dataMalloc();
+    gNew->dataMalloc();
+    for (auto graph : {g, gNew}) {
+        graph->getInputs()[0]->setData(IncrementalGenerator());
+        graph->getInputs()[1]->setData(ValGenerator<2>());
+        runtime->run(graph);
+    }
+    EXPECT_TRUE(gNew->getOutputs()[0]->equalData(g->getOutputs()[0]));
+}
+
+} // namespace infini